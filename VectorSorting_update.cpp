@@ -7,223 +7,2695 @@
 //============================================================================
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
 #include <time.h>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 #include "CSVparser.hpp"
 
 using namespace std;
 
 //============================================================================
-// Global definitions visible to all methods and classes
+// Global definitions visible to all methods and classes
+//============================================================================
+
+// forward declarations
+double strToDouble(string str, char ch);
+
+// how titles are ordered by the sorts and the title indexes
+enum Collation {
+    COLLATE_BYTES,   // raw byte order, as title.compare() gives
+    COLLATE_CASE,    // case-insensitive
+    COLLATE_ACCENTS  // case- and accent-insensitive
+};
+
+Collation gCollation = COLLATE_BYTES;
+
+// define a structure to hold bid information; its strings allocate from
+// the same memory resource as the container holding it
+struct Bid {
+    typedef pmr::polymorphic_allocator<char> allocator_type;
+
+    pmr::string bidId; // unique identifier
+    pmr::string title;
+    pmr::string titleKey; // binary sort key for title, empty under COLLATE_BYTES
+    pmr::string fund;
+    double amount;
+    Bid() {
+        amount = 0.0;
+    }
+    explicit Bid(const allocator_type& alloc)
+            : bidId(alloc), title(alloc), titleKey(alloc), fund(alloc) {
+        amount = 0.0;
+    }
+    Bid(const Bid& other, const allocator_type& alloc)
+            : bidId(other.bidId, alloc), title(other.title, alloc),
+              titleKey(other.titleKey, alloc), fund(other.fund, alloc) {
+        amount = other.amount;
+    }
+    Bid(Bid&& other, const allocator_type& alloc)
+            : bidId(move(other.bidId), alloc), title(move(other.title), alloc),
+              titleKey(move(other.titleKey), alloc), fund(move(other.fund), alloc) {
+        amount = other.amount;
+    }
+    Bid(const Bid&) = default;
+    Bid(Bid&&) = default;
+    Bid& operator=(const Bid&) = default;
+    Bid& operator=(Bid&&) = default;
+};
+
+//============================================================================
+// Memory accounting
+//============================================================================
+
+/**
+ * Allocation counters, updated lock-free from any thread
+ */
+struct AllocCounters {
+    atomic<uint64_t> allocations;
+    atomic<uint64_t> bytesAllocated; // running total of bytes handed out
+    atomic<uint64_t> bytesInUse;
+    atomic<uint64_t> peakBytes;      // high-water mark of bytesInUse since the last reset
+
+    constexpr AllocCounters() : allocations(0), bytesAllocated(0), bytesInUse(0), peakBytes(0) {
+    }
+
+    void onAllocate(uint64_t bytes) {
+        allocations.fetch_add(1, memory_order_relaxed);
+        bytesAllocated.fetch_add(bytes, memory_order_relaxed);
+        uint64_t inUse = bytesInUse.fetch_add(bytes, memory_order_relaxed) + bytes;
+        uint64_t peak = peakBytes.load(memory_order_relaxed);
+        while (inUse > peak && !peakBytes.compare_exchange_weak(peak, inUse, memory_order_relaxed)) {
+        }
+    }
+
+    void onDeallocate(uint64_t bytes) {
+        bytesInUse.fetch_sub(bytes, memory_order_relaxed);
+    }
+};
+
+// every operator new/delete in the process, including csv::Parser's
+AllocCounters gHeapCounters;
+
+/**
+ * Memory resource that counts what passes through it on the way to an
+ * upstream resource. Bid containers are built with it (it is installed
+ * as the default pmr resource), which gives exact per-phase allocation
+ * counts for the records and their strings.
+ */
+class CountingResource : public pmr::memory_resource {
+public:
+    explicit CountingResource(pmr::memory_resource* upstream) : upstream(upstream) {
+    }
+
+    const AllocCounters& counters() const {
+        return stats;
+    }
+
+    void resetPeak() {
+        stats.peakBytes.store(stats.bytesInUse.load());
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        void* p = upstream->allocate(bytes, alignment);
+        stats.onAllocate(bytes);
+        return p;
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        stats.onDeallocate(bytes);
+        upstream->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    pmr::memory_resource* upstream;
+    AllocCounters stats;
+};
+
+CountingResource gBidMemory(pmr::new_delete_resource());
+
+// first block of a load arena; later blocks grow geometrically
+const size_t ARENA_BLOCK = 1 << 20;
+
+// heap held by csv::Parser while the last file was loaded
+uint64_t gParserBytes = 0;
+
+/**
+ * Counters captured over one named phase of work (load, index, sort...)
+ */
+struct MemoryPhase {
+    string name;
+    double seconds;
+    uint64_t heapAllocations;  // every operator new during the phase
+    uint64_t heapBytes;
+    uint64_t heapPeak;         // most heap in use at any point of the phase
+    uint64_t bidAllocations;   // allocations through gBidMemory
+    uint64_t bidBytes;
+    long peakRssKb;            // process peak RSS when the phase ended
+};
+
+vector<MemoryPhase> gMemoryPhases;
+
+/**
+ * Peak resident set size of the process so far, in KB
+ */
+long peakRssKb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * Current resident set size of the process, in KB
+ */
+long currentRssKb() {
+    long pages = 0, resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(statm);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * Records a MemoryPhase covering the lifetime of the object
+ */
+class MemoryPhaseScope {
+public:
+    explicit MemoryPhaseScope(const string& name) {
+        phase.name = name;
+        gHeapCounters.peakBytes.store(gHeapCounters.bytesInUse.load());
+        gBidMemory.resetPeak();
+        heapAllocations = gHeapCounters.allocations.load();
+        heapBytes = gHeapCounters.bytesAllocated.load();
+        bidAllocations = gBidMemory.counters().allocations.load();
+        bidBytes = gBidMemory.counters().bytesAllocated.load();
+        start = chrono::steady_clock::now();
+    }
+
+    ~MemoryPhaseScope() {
+        phase.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        phase.heapAllocations = gHeapCounters.allocations.load() - heapAllocations;
+        phase.heapBytes = gHeapCounters.bytesAllocated.load() - heapBytes;
+        phase.heapPeak = gHeapCounters.peakBytes.load();
+        phase.bidAllocations = gBidMemory.counters().allocations.load() - bidAllocations;
+        phase.bidBytes = gBidMemory.counters().bytesAllocated.load() - bidBytes;
+        phase.peakRssKb = peakRssKb();
+        gMemoryPhases.push_back(phase);
+    }
+
+private:
+    MemoryPhase phase;
+    uint64_t heapAllocations, heapBytes, bidAllocations, bidBytes;
+    chrono::steady_clock::time_point start;
+};
+
+
+//============================================================================
+
+/**
+ * Count every heap allocation in the process; malloc_usable_size() gives
+ * the size back on delete without a header of our own
+ */
+void* operator new(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (p == NULL) {
+        throw bad_alloc();
+    }
+    gHeapCounters.onAllocate(malloc_usable_size(p));
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    if (p != NULL) {
+        gHeapCounters.onDeallocate(malloc_usable_size(p));
+        free(p);
+    }
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    void* p = aligned_alloc((size_t) alignment, (size + (size_t) alignment - 1) & ~((size_t) alignment - 1));
+    if (p == NULL) {
+        throw bad_alloc();
+    }
+    gHeapCounters.onAllocate(malloc_usable_size(p));
+    return p;
+}
+
+void operator delete(void* p, align_val_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t, align_val_t) noexcept {
+    operator delete(p);
+}
+
+/**
+ * Display the bid information to the console (std::out)
+ *
+ * @param bid struct containing the bid info
+ */
+void displayBid(Bid bid) {
+    cout << bid.bidId << ": " << bid.title << " | " << bid.amount << " | "
+            << bid.fund << endl;
+    return;
+}
+
+/**
+ * Prompt user for bid information using console (std::in)
+ *
+ * @return Bid struct containing the bid info
+ */
+Bid getBid() {
+    Bid bid;
+
+    cout << "Enter Id: ";
+    cin.ignore();
+    getline(cin, bid.bidId);
+
+    cout << "Enter title: ";
+    getline(cin, bid.title);
+
+    cout << "Enter fund: ";
+    cin >> bid.fund;
+
+    cout << "Enter amount: ";
+    cin.ignore();
+    string strAmount;
+    getline(cin, strAmount);
+    bid.amount = strToDouble(strAmount, '$');
+
+    return bid;
+}
+
+//============================================================================
+// Title collation
+//============================================================================
+
+/**
+ * Base letters for U+00C0..U+017F with accents removed; '*' marks the
+ * letters that expand to two characters and are handled separately
+ */
+const char* const LATIN_BASE =
+        "aaaaaa*ceeeeiiii" "dnooooo*ouuuuy**"   // U+00C0..U+00DF
+        "aaaaaa*ceeeeiiii" "dnooooo*ouuuuy*y"   // U+00E0..U+00FF
+        "aaaaaaccccccccdd" "ddeeeeeeeeeegggg"   // U+0100..U+011F
+        "gggghhhhiiiiiiii" "ii**jjkkklllllll"   // U+0120..U+013F
+        "lllnnnnnnnnnoooo" "oo**rrrrrrssssss"   // U+0140..U+015F
+        "ssttttttuuuuuuuu" "uuuuwwyyyzzzzzzs";  // U+0160..U+017F
+
+/**
+ * Lower-case a code point in the Basic Latin, Latin-1 and Latin
+ * Extended-A blocks; anything else is returned unchanged
+ */
+unsigned int foldCase(unsigned int cp) {
+    if (cp >= 'A' && cp <= 'Z') {
+        return cp + 32;
+    }
+    if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) {
+        return cp + 32;
+    }
+    if (cp == 0x130) {
+        return 'i';
+    }
+    if (cp == 0x178) {
+        return 0xFF;
+    }
+    if ((cp >= 0x100 && cp <= 0x137) || (cp >= 0x14A && cp <= 0x177)) {
+        return cp | 1;
+    }
+    if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) {
+        return (cp & 1) ? cp + 1 : cp;
+    }
+    return cp;
+}
+
+/**
+ * Append a code point to a string as UTF-8
+ */
+void appendUtf8(string& out, unsigned int cp) {
+    if (cp < 0x80) {
+        out += (char) cp;
+    } else if (cp < 0x800) {
+        out += (char) (0xC0 | (cp >> 6));
+        out += (char) (0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char) (0xE0 | (cp >> 12));
+        out += (char) (0x80 | ((cp >> 6) & 0x3F));
+        out += (char) (0x80 | (cp & 0x3F));
+    } else {
+        out += (char) (0xF0 | (cp >> 18));
+        out += (char) (0x80 | ((cp >> 12) & 0x3F));
+        out += (char) (0x80 | ((cp >> 6) & 0x3F));
+        out += (char) (0x80 | (cp & 0x3F));
+    }
+}
+
+/**
+ * Fold a title to the primary part of its collation key: case folded,
+ * and with accents stripped when the collation asks for it. Malformed
+ * UTF-8 bytes are passed through as-is.
+ *
+ * @param title the raw title bytes
+ * @param collation which folding to apply
+ */
+string foldTitle(string_view title, Collation collation) {
+    string out;
+    out.reserve(title.size());
+    size_t i = 0;
+    while (i < title.size()) {
+        unsigned char c = title[i];
+        unsigned int cp = c;
+        size_t len = 1;
+        if (c >= 0xC0 && c < 0xE0 && i + 1 < title.size()) {
+            cp = ((c & 0x1F) << 6) | (title[i + 1] & 0x3F);
+            len = 2;
+        } else if (c >= 0xE0 && c < 0xF0 && i + 2 < title.size()) {
+            cp = ((c & 0x0F) << 12) | ((title[i + 1] & 0x3F) << 6) | (title[i + 2] & 0x3F);
+            len = 3;
+        } else if (c >= 0xF0 && i + 3 < title.size()) {
+            cp = ((c & 0x07) << 18) | ((title[i + 1] & 0x3F) << 12)
+                    | ((title[i + 2] & 0x3F) << 6) | (title[i + 3] & 0x3F);
+            len = 4;
+        } else if (c >= 0x80) {
+            // stray continuation or truncated sequence
+            out += (char) c;
+            ++i;
+            continue;
+        }
+        i += len;
+
+        cp = foldCase(cp);
+        if (collation == COLLATE_ACCENTS && cp >= 0xC0 && cp <= 0x17F) {
+            char base = LATIN_BASE[cp - 0xC0];
+            if (base != '*') {
+                out += base;
+                continue;
+            }
+            switch (cp) {
+            case 0xE6: out += "ae"; continue;
+            case 0xDF: out += "ss"; continue;
+            case 0xFE: out += "th"; continue;
+            case 0x133: out += "ij"; continue;
+            case 0x153: out += "oe"; continue;
+            }
+            // multiplication and division signs are not letters
+        }
+        appendUtf8(out, cp);
+    }
+    return out;
+}
+
+/**
+ * Build the binary sort key for a title. The folded text comes first so
+ * keys order case- (and accent-) insensitively under plain memcmp; a NUL
+ * and the raw title follow so titles that fold alike still sort in a
+ * stable, deterministic order.
+ */
+string makeTitleKey(string_view title, Collation collation) {
+    string key = foldTitle(title, collation);
+    key += '\0';
+    key += title;
+    return key;
+}
+
+/**
+ * The bytes sorts should compare for a bid under the active collation
+ */
+inline const pmr::string& sortTitle(const Bid& bid) {
+    return gCollation == COLLATE_BYTES ? bid.title : bid.titleKey;
+}
+
+/**
+ * Turn search text into something comparable with sortTitle() prefixes
+ */
+string collationPrefix(const string& text) {
+    return gCollation == COLLATE_BYTES ? text : foldTitle(text, gCollation);
+}
+
+/**
+ * Recompute every sort key after the active collation changed
+ *
+ * @param bids address of the vector<Bid> instance to update
+ */
+void applyCollation(pmr::vector<Bid>& bids) {
+    for (size_t i = 0; i < bids.size(); ++i) {
+        if (gCollation == COLLATE_BYTES) {
+            bids[i].titleKey.clear();
+            bids[i].titleKey.shrink_to_fit();
+        } else {
+            bids[i].titleKey = makeTitleKey(bids[i].title, gCollation);
+        }
+    }
+}
+
+/**
+ * Parse a --collate value
+ *
+ * @return false if the name is not recognised
+ */
+bool parseCollation(const string& name, Collation& collation) {
+    if (name == "bytes") {
+        collation = COLLATE_BYTES;
+    } else if (name == "case") {
+        collation = COLLATE_CASE;
+    } else if (name == "accents") {
+        collation = COLLATE_ACCENTS;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* collationName(Collation collation) {
+    switch (collation) {
+    case COLLATE_CASE: return "case";
+    case COLLATE_ACCENTS: return "accents";
+    default: return "bytes";
+    }
+}
+
+//============================================================================
+// Vectorised CSV tokenizer
+//============================================================================
+
+// which tokenizer loadBids() uses
+enum CsvParserKind {
+    CSV_SIMD,    // structural scanner below
+    CSV_CLASSIC  // csv::Parser, one byte at a time
+};
+
+CsvParserKind gCsvParser = CSV_SIMD;
+
+// instruction set the structural scanner runs with
+enum ScanTier {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2
+};
+
+/**
+ * Field boundaries found by the structural scanner: the offset of the
+ * comma or newline that ends each field, and for every line the index in
+ * ends one past its last field
+ */
+struct CsvFields {
+    unique_ptr<uint32_t[]> ends;
+    unique_ptr<uint32_t[]> rowEnds;
+    size_t endCount;
+    size_t rowCount;
+    size_t endCapacity;
+    size_t rowCapacity;
+
+    CsvFields() : endCount(0), rowCount(0), endCapacity(0), rowCapacity(0) {
+    }
+};
+
+/**
+ * Grow a boundary array, keeping its first count entries; the arrays are
+ * left uninitialised so a scan never pays to zero them
+ */
+void growBoundaries(unique_ptr<uint32_t[]>& array, size_t count, size_t& capacity, size_t wanted) {
+    if (wanted <= capacity) {
+        return;
+    }
+    unique_ptr<uint32_t[]> grown(new uint32_t[wanted]);
+    if (count > 0) {
+        memcpy(grown.get(), array.get(), count * sizeof(uint32_t));
+    }
+    array.swap(grown);
+    capacity = wanted;
+}
+
+/**
+ * Make room for the worst case of one 64-byte block (every byte a field
+ * end) so the block loop can store without bounds checks
+ */
+inline void reserveBlock(CsvFields& out) {
+    if (out.endCount + 68 > out.endCapacity) {
+        growBoundaries(out.ends, out.endCount, out.endCapacity, out.endCapacity * 2 + 1024);
+    }
+    if (out.rowCount + 64 > out.rowCapacity) {
+        growBoundaries(out.rowEnds, out.rowCount, out.rowCapacity, out.rowCapacity * 2 + 1024);
+    }
+}
+
+/**
+ * Record every unquoted comma and newline of one 64-byte block
+ *
+ * @param quotes bit i set when byte i is a double quote
+ * @param separators bit i set when byte i is a comma or newline
+ * @param newlines bit i set when byte i is a newline
+ * @param quoteRegion prefix XOR of quotes: bit i set inside a quoted field
+ * @param base file offset of the block
+ */
+inline void emitBlock(uint64_t separators, uint64_t newlines, uint64_t quoteRegion, uint32_t base,
+        CsvFields& out) {
+    uint64_t structural = separators & ~quoteRegion;
+    int count = __builtin_popcountll(structural);
+
+    // unrolled by four without a data-dependent branch; the slots written
+    // past count are scratch space that reserveBlock() set aside
+    uint32_t* ends = out.ends.get() + out.endCount;
+    uint64_t bits = structural;
+    for (int i = 0; i < count; i += 4) {
+        ends[i] = base + (bits ? __builtin_ctzll(bits) : 0);
+        bits &= bits - 1;
+        ends[i + 1] = base + (bits ? __builtin_ctzll(bits) : 0);
+        bits &= bits - 1;
+        ends[i + 2] = base + (bits ? __builtin_ctzll(bits) : 0);
+        bits &= bits - 1;
+        ends[i + 3] = base + (bits ? __builtin_ctzll(bits) : 0);
+        bits &= bits - 1;
+    }
+
+    // a line ends after as many fields as there are field ends up to its newline
+    uint64_t lineEnds = newlines & structural;
+    while (lineEnds != 0) {
+        int pos = __builtin_ctzll(lineEnds);
+        uint64_t upTo = (2ULL << pos) - 1;
+        out.rowEnds[out.rowCount++] = (uint32_t) (out.endCount + __builtin_popcountll(structural & upTo));
+        lineEnds &= lineEnds - 1;
+    }
+    out.endCount += count;
+}
+
+/**
+ * Portable prefix XOR: bit i of the result is the XOR of bits 0..i
+ */
+inline uint64_t prefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+/**
+ * Scan whole 64-byte blocks one byte at a time
+ *
+ * @param inQuotes all ones while the scan is inside a quoted field
+ */
+void scanBlocksScalar(const unsigned char* data, size_t blocks, uint32_t base, uint64_t& inQuotes,
+        CsvFields& out) {
+    for (size_t b = 0; b < blocks; ++b) {
+        const unsigned char* p = data + b * 64;
+        uint64_t quotes = 0, separators = 0, newlines = 0;
+        for (int i = 0; i < 64; ++i) {
+            quotes |= (uint64_t) (p[i] == '"') << i;
+            separators |= (uint64_t) (p[i] == ',' || p[i] == '\n') << i;
+            newlines |= (uint64_t) (p[i] == '\n') << i;
+        }
+        uint64_t region = prefixXor(quotes) ^ inQuotes;
+        inQuotes = (uint64_t) ((int64_t) region >> 63);
+        reserveBlock(out);
+        emitBlock(separators, newlines, region, base + (uint32_t) (b * 64), out);
+    }
+}
+
+#if defined(__x86_64__)
+
+/**
+ * Scan 64-byte blocks as four SSE2 vectors; quoted regions come from a
+ * carry-less multiply of the quote mask by all ones
+ */
+__attribute__((target("sse2,pclmul")))
+void scanBlocksSse2(const unsigned char* data, size_t blocks, uint32_t base, uint64_t& inQuotes,
+        CsvFields& out) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i ones = _mm_set1_epi8((char) 0xFF);
+
+    for (size_t b = 0; b < blocks; ++b) {
+        const unsigned char* p = data + b * 64;
+        uint64_t quotes = 0, separators = 0, newlines = 0;
+        for (int i = 0; i < 4; ++i) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*) (p + 16 * i));
+            __m128i isNewline = _mm_cmpeq_epi8(chunk, newline);
+            quotes |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)) << (16 * i);
+            separators |= (uint64_t) (uint16_t) _mm_movemask_epi8(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, comma), isNewline)) << (16 * i);
+            newlines |= (uint64_t) (uint16_t) _mm_movemask_epi8(isNewline) << (16 * i);
+        }
+        uint64_t region = (uint64_t) _mm_cvtsi128_si64(
+                _mm_clmulepi64_si128(_mm_set_epi64x(0, (long long) quotes), ones, 0)) ^ inQuotes;
+        inQuotes = (uint64_t) ((int64_t) region >> 63);
+        reserveBlock(out);
+        emitBlock(separators, newlines, region, base + (uint32_t) (b * 64), out);
+    }
+}
+
+/**
+ * Scan 64-byte blocks as two AVX2 vectors
+ */
+__attribute__((target("avx2,pclmul")))
+void scanBlocksAvx2(const unsigned char* data, size_t blocks, uint32_t base, uint64_t& inQuotes,
+        CsvFields& out) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m128i ones = _mm_set1_epi8((char) 0xFF);
+
+    for (size_t b = 0; b < blocks; ++b) {
+        const unsigned char* p = data + b * 64;
+        __m256i lo = _mm256_loadu_si256((const __m256i*) p);
+        __m256i hi = _mm256_loadu_si256((const __m256i*) (p + 32));
+        __m256i loNewline = _mm256_cmpeq_epi8(lo, newline);
+        __m256i hiNewline = _mm256_cmpeq_epi8(hi, newline);
+
+        uint64_t quotes = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, quote))
+                | (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, quote)) << 32;
+        uint64_t separators = (uint32_t) _mm256_movemask_epi8(
+                        _mm256_or_si256(_mm256_cmpeq_epi8(lo, comma), loNewline))
+                | (uint64_t) (uint32_t) _mm256_movemask_epi8(
+                        _mm256_or_si256(_mm256_cmpeq_epi8(hi, comma), hiNewline)) << 32;
+        uint64_t newlines = (uint32_t) _mm256_movemask_epi8(loNewline)
+                | (uint64_t) (uint32_t) _mm256_movemask_epi8(hiNewline) << 32;
+
+        uint64_t region = (uint64_t) _mm_cvtsi128_si64(
+                _mm_clmulepi64_si128(_mm_set_epi64x(0, (long long) quotes), ones, 0)) ^ inQuotes;
+        inQuotes = (uint64_t) ((int64_t) region >> 63);
+        reserveBlock(out);
+        emitBlock(separators, newlines, region, base + (uint32_t) (b * 64), out);
+    }
+}
+
+#endif
+
+/**
+ * @return the fastest scanner tier this CPU can run
+ */
+ScanTier bestScanTier() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("pclmul")) {
+        return SCAN_AVX2;
+    }
+    if (__builtin_cpu_supports("pclmul")) {
+        return SCAN_SSE2;
+    }
+#endif
+    return SCAN_SCALAR;
+}
+
+const char* scanTierName(ScanTier tier) {
+    switch (tier) {
+    case SCAN_AVX2: return "avx2";
+    case SCAN_SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+/**
+ * Find every field boundary in a CSV buffer. Quotes toggle the quoted
+ * state exactly as csv::Parser does, so doubled quotes inside a quoted
+ * field need no special case; unlike csv::Parser, a newline inside quotes
+ * stays part of the field.
+ *
+ * @param data the file contents
+ * @param size number of bytes in data, below 4 GB
+ * @param tier instruction set to scan with
+ * @param out receives the field and line boundaries
+ */
+void scanCsv(const char* data, size_t size, ScanTier tier, CsvFields& out) {
+    out.endCount = 0;
+    out.rowCount = 0;
+    growBoundaries(out.ends, 0, out.endCapacity, size / 8 + 1024);
+    growBoundaries(out.rowEnds, 0, out.rowCapacity, size / 64 + 1024);
+
+    const unsigned char* bytes = (const unsigned char*) data;
+    size_t blocks = size / 64;
+    uint64_t inQuotes = 0;
+    switch (tier) {
+#if defined(__x86_64__)
+    case SCAN_AVX2:
+        scanBlocksAvx2(bytes, blocks, 0, inQuotes, out);
+        break;
+    case SCAN_SSE2:
+        scanBlocksSse2(bytes, blocks, 0, inQuotes, out);
+        break;
+#endif
+    default:
+        scanBlocksScalar(bytes, blocks, 0, inQuotes, out);
+    }
+
+    // the tail goes through a zero-padded copy so no kernel reads past the end
+    if (size % 64 != 0) {
+        unsigned char tail[64] = { 0 };
+        memcpy(tail, bytes + blocks * 64, size % 64);
+        scanBlocksScalar(tail, 1, (uint32_t) (blocks * 64), inQuotes, out);
+    }
+    if (size > 0 && data[size - 1] != '\n') {
+        reserveBlock(out);
+        out.ends[out.endCount++] = (uint32_t) size;
+        out.rowEnds[out.rowCount++] = (uint32_t) out.endCount;
+    }
+}
+
+/**
+ * Read-only memory mapping of a whole file
+ */
+struct MappedFile {
+    const char* data;
+    size_t size;
+
+    MappedFile() : data(NULL), size(0) {
+    }
+
+    ~MappedFile() {
+        if (data != NULL && size > 0) {
+            munmap((void*) data, size);
+        }
+    }
+
+    /**
+     * @return false if the file cannot be opened or mapped
+     */
+    bool open(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        bool ok = fstat(fd, &info) == 0;
+        size = ok ? (size_t) info.st_size : 0;
+        if (ok && size > 0) {
+            void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = mapped != MAP_FAILED;
+            if (ok) {
+                data = (const char*) mapped;
+                madvise(mapped, size, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+        return ok;
+    }
+};
+
+/**
+ * Walks the lines found by scanCsv(), skipping empty lines like
+ * csv::Parser does
+ */
+class CsvRows {
+public:
+    CsvRows(const char* data, const CsvFields& fields) : data(data), fields(fields), line(0) {
+    }
+
+    /**
+     * Advance to the next non-empty line
+     *
+     * @return false at the end of the file
+     */
+    bool next() {
+        while (line < fields.rowCount) {
+            first = line == 0 ? 0 : fields.rowEnds[line - 1];
+            last = fields.rowEnds[line];
+            ++line;
+            if (last - first > 1 || start(0) != fields.ends[first]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t size() const {
+        return last - first;
+    }
+
+    string_view operator[](size_t column) const {
+        size_t begin = start(column);
+        return string_view(data + begin, fields.ends[first + column] - begin);
+    }
+
+private:
+    size_t start(size_t column) const {
+        size_t field = first + column;
+        return field == 0 ? 0 : fields.ends[field - 1] + 1;
+    }
+
+    const char* data;
+    const CsvFields& fields;
+    size_t line;
+    size_t first;
+    size_t last;
+};
+
+/**
+ * loadBids() on top of the structural scanner
+ */
+pmr::vector<Bid> loadBidsSimd(string csvPath, pmr::memory_resource* memory) {
+    pmr::vector<Bid> bids(memory);
+
+    MappedFile file;
+    if (!file.open(csvPath)) {
+        throw csv::Error(string("Failed to open ").append(csvPath));
+    }
+    if (file.size >= UINT32_MAX) {
+        throw csv::Error(csvPath + " is too large for the structural scanner");
+    }
+
+    CsvFields fields;
+    scanCsv(file.data, file.size, bestScanTier(), fields);
+    gParserBytes = (fields.endCapacity + fields.rowCapacity) * sizeof(uint32_t);
+
+    CsvRows rows(file.data, fields);
+    if (!rows.next()) {
+        throw csv::Error(string("No Data in ").append(csvPath));
+    }
+    size_t columns = rows.size();
+    bids.reserve(fields.rowCount);
+
+    while (rows.next()) {
+        if (rows.size() != columns || columns < 9) {
+            cerr << "CSVparser : corrupted data !" << endl;
+            break;
+        }
+        Bid& bid = bids.emplace_back();
+        bid.bidId = rows[1];
+        bid.title = rows[0];
+        bid.fund = rows[8];
+        bid.amount = strToDouble(string(rows[4]), '$');
+        if (gCollation != COLLATE_BYTES) {
+            bid.titleKey = makeTitleKey(bid.title, gCollation);
+        }
+    }
+    return bids;
+}
+
+/**
+ * Compare one scan of a file with csv::Parser's rows, printing the first
+ * few differences
+ *
+ * @return number of mismatches found, at most 5
+ */
+int compareScan(const csv::Parser& classic, const char* data, const CsvFields& fields) {
+    CsvRows rows(data, fields);
+    rows.next(); // header
+    int mismatches = 0;
+    unsigned int row = 0;
+    for (; rows.next() && mismatches < 5; ++row) {
+        if (row >= classic.rowCount()) {
+            cout << "extra row " << row << " from the scanner" << endl;
+            ++mismatches;
+            break;
+        }
+        csv::Row& expected = classic[row];
+        if (expected.size() != rows.size()) {
+            cout << "row " << row << ": " << rows.size() << " fields, expected " << expected.size() << endl;
+            ++mismatches;
+            continue;
+        }
+        for (unsigned int column = 0; column < expected.size(); ++column) {
+            if (rows[column] != string_view(expected[column])) {
+                cout << "row " << row << " field " << column << ": \"" << rows[column]
+                        << "\", expected \"" << expected[column] << "\"" << endl;
+                ++mismatches;
+                break;
+            }
+        }
+    }
+    if (mismatches == 0 && row != classic.rowCount()) {
+        cout << "scanner found " << row << " rows, expected " << classic.rowCount() << endl;
+        ++mismatches;
+    }
+    return mismatches;
+}
+
+/**
+ * Check every scanner tier this CPU runs against csv::Parser on a real
+ * file and time them all: every field of every row must match byte for
+ * byte
+ *
+ * @param csvPath the path to the CSV file to check
+ * @return process exit code, 0 when the outputs are identical
+ */
+int checkCsv(string csvPath) {
+    MappedFile file;
+    if (!file.open(csvPath) || file.size >= UINT32_MAX) {
+        cerr << "Cannot map " << csvPath << endl;
+        return 1;
+    }
+    const double MB = 1024.0 * 1024.0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    unique_ptr<csv::Parser> parsed;
+    try {
+        parsed.reset(new csv::Parser(csvPath));
+    } catch (csv::Error &e) {
+        cout << "csv::Parser rejects " << csvPath << ": " << e.what() << endl;
+        return 1;
+    }
+    const csv::Parser& classic = *parsed;
+    double classicSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "csv::Parser: " << file.size / MB / classicSeconds << " MB/s" << endl;
+
+    CsvFields fields;
+    ScanTier best = bestScanTier();
+    int failedTiers = 0;
+    for (int tier = SCAN_SCALAR; tier <= best; ++tier) {
+        double bestSeconds = 1e9;
+        for (int run = 0; run < 3; ++run) {
+            start = chrono::steady_clock::now();
+            scanCsv(file.data, file.size, (ScanTier) tier, fields);
+            bestSeconds = min(bestSeconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        int mismatches = compareScan(classic, file.data, fields);
+        cout << "scanner (" << scanTierName((ScanTier) tier) << "): "
+                << file.size / MB / 1024.0 / bestSeconds << " GB/s, "
+                << (mismatches == 0 ? "matches" : "DIFFERS") << endl;
+        failedTiers += mismatches == 0 ? 0 : 1;
+    }
+
+    cout << (failedTiers == 0 ? "PASS" : "FAIL") << ": " << classic.rowCount() << " rows compared for "
+            << best + 1 << " scanner tiers" << endl;
+    return failedTiers == 0 ? 0 : 1;
+}
+
+/**
+ * Load a CSV file containing bids into a container
+ *
+ * @param csvPath the path to the CSV file to load
+ * @param memory resource the container and every string in it allocate
+ *               from; pass an arena to make the whole load one block chain
+ * @return a container holding all the bids read
+ */
+pmr::vector<Bid> loadBids(string csvPath, pmr::memory_resource* memory = pmr::get_default_resource()) {
+    cout << "Loading CSV file " << csvPath << endl;
+
+    if (gCsvParser == CSV_SIMD) {
+        return loadBidsSimd(csvPath, memory);
+    }
+
+    // Define a vector data structure to hold a collection of bids.
+    pmr::vector<Bid> bids(memory);
+
+    // initialize the CSV Parser using the given path, noting how much heap
+    // its line and row buffers take
+    uint64_t heapBefore = gHeapCounters.bytesInUse.load();
+    csv::Parser file = csv::Parser(csvPath);
+    gParserBytes = gHeapCounters.bytesInUse.load() - heapBefore;
+
+    // size the array once; in an arena a regrown array would strand the
+    // old one until the whole arena is released
+    bids.reserve(file.rowCount());
+
+    int i = 0;
+    try {
+        // loop to read rows of a CSV file
+        for (i = 0; i < file.rowCount(); i++) {
+
+            // Construct the bid in place so its strings are allocated
+            // straight from the container's resource, with no copy
+            Bid& bid = bids.emplace_back();
+            bid.bidId = file[i][1];
+            bid.title = file[i][0];
+            bid.fund = file[i][8];
+            bid.amount = strToDouble(file[i][4], '$');
+            if (gCollation != COLLATE_BYTES) {
+                bid.titleKey = makeTitleKey(bid.title, gCollation);
+            }
+        }
+    } catch (csv::Error &e) {
+        std::cerr << e.what() << std::endl;
+
+        // drop the bid whose row turned out to be bad
+        if (bids.size() > (size_t) i) {
+            bids.pop_back();
+        }
+    }
+    return bids;
+}
+
+//============================================================================
+// Title search index
+//============================================================================
+
+/**
+ * Compact search index over bid titles, built once per load.
+ *
+ * Prefix queries binary-search a permutation of the bids ordered by
+ * sortTitle(). Substring queries use an inverted index of byte trigrams
+ * over the collation-folded titles; each posting list holds ascending
+ * bid positions, delta encoded as LEB128 varints, and candidates are
+ * verified against the title text before they are returned.
+ */
+struct TitleIndex {
+    vector<uint32_t> byTitle;       // bid positions ordered by sortTitle()
+    vector<uint32_t> grams;         // distinct trigrams, ascending
+    vector<uint32_t> postingCount;  // number of bids containing each trigram
+    vector<uint64_t> postingStart;  // byte offset of each list, plus an end sentinel
+    vector<uint8_t> postings;       // delta + varint encoded bid positions
+};
+
+// bids per unit of parallel index work
+const size_t INDEX_CHUNK = 1 << 18;
+
+/**
+ * The folded text a title is searched by: the title itself under byte
+ * collation, otherwise the part of its sort key before the NUL
+ */
+inline string_view searchText(const Bid& bid) {
+    if (gCollation == COLLATE_BYTES) {
+        return string_view(bid.title);
+    }
+    return string_view(bid.titleKey.data(), strlen(bid.titleKey.c_str()));
+}
+
+void appendVarint(vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t) value);
+}
+
+const uint8_t* readVarint(const uint8_t* p, uint32_t& value) {
+    value = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        value |= (uint32_t) (*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= (uint32_t) *p++ << shift;
+    return p;
+}
+
+/**
+ * Collect the distinct byte trigrams of a text, in ascending order
+ */
+void collectGrams(string_view text, vector<uint32_t>& grams) {
+    grams.clear();
+    for (size_t i = 0; i + 3 <= text.size(); ++i) {
+        grams.push_back(((uint32_t) (unsigned char) text[i] << 16)
+                | ((uint32_t) (unsigned char) text[i + 1] << 8)
+                | (uint32_t) (unsigned char) text[i + 2]);
+    }
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+}
+
+/**
+ * Inverted index over one contiguous range of bids; chunks are built in
+ * parallel and then stitched together
+ */
+struct GramChunk {
+    vector<uint32_t> grams;
+    vector<uint32_t> counts;
+    vector<uint32_t> lasts;     // last bid position in each list
+    vector<uint64_t> starts;    // plus an end sentinel
+    vector<uint8_t> postings;   // first entry of every list is absolute
+};
+
+void buildGramChunk(const pmr::vector<Bid>& bids, size_t begin, size_t end, GramChunk& chunk) {
+    // (trigram, bid position) pairs; sorting them groups every list
+    vector<uint64_t> pairs;
+    vector<uint32_t> grams;
+    for (size_t i = begin; i < end; ++i) {
+        collectGrams(searchText(bids[i]), grams);
+        for (size_t g = 0; g < grams.size(); ++g) {
+            pairs.push_back(((uint64_t) grams[g] << 32) | i);
+        }
+    }
+    sort(pairs.begin(), pairs.end());
+
+    for (size_t p = 0; p < pairs.size(); ++p) {
+        uint32_t gram = (uint32_t) (pairs[p] >> 32);
+        uint32_t position = (uint32_t) pairs[p];
+        if (chunk.grams.empty() || chunk.grams.back() != gram) {
+            chunk.grams.push_back(gram);
+            chunk.counts.push_back(0);
+            chunk.lasts.push_back(0);
+            chunk.starts.push_back(chunk.postings.size());
+        }
+        appendVarint(chunk.postings, position - chunk.lasts.back());
+        chunk.lasts.back() = position;
+        ++chunk.counts.back();
+    }
+    chunk.starts.push_back(chunk.postings.size());
+}
+
+/**
+ * Build the prefix and trigram indexes over all bids using every core
+ *
+ * @param bids the bids to index; positions refer to this vector
+ * @return the finished index
+ */
+TitleIndex buildTitleIndex(const pmr::vector<Bid>& bids) {
+    TitleIndex index;
+    size_t threadCount = max(1u, thread::hardware_concurrency());
+    size_t chunkCount = (bids.size() + INDEX_CHUNK - 1) / INDEX_CHUNK;
+    vector<GramChunk> chunks(chunkCount);
+    atomic<size_t> nextChunk(0);
+
+    // prefix permutation: sort one slice per thread, then merge the slices
+    index.byTitle.resize(bids.size());
+    for (size_t i = 0; i < bids.size(); ++i) {
+        index.byTitle[i] = (uint32_t) i;
+    }
+    auto titleLess = [&bids](uint32_t a, uint32_t b) {
+        return sortTitle(bids[a]).compare(sortTitle(bids[b])) < 0;
+    };
+    vector<size_t> bounds;
+    for (size_t t = 0; t <= threadCount; ++t) {
+        bounds.push_back(bids.size() * t / threadCount);
+    }
+
+    vector<thread> workers;
+    for (size_t t = 0; t < threadCount; ++t) {
+        workers.push_back(thread([&, t]() {
+            sort(index.byTitle.begin() + bounds[t], index.byTitle.begin() + bounds[t + 1], titleLess);
+            for (size_t c = nextChunk++; c < chunkCount; c = nextChunk++) {
+                buildGramChunk(bids, c * INDEX_CHUNK, min(bids.size(), (c + 1) * INDEX_CHUNK), chunks[c]);
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); ++t) {
+        workers[t].join();
+    }
+    for (size_t width = 1; width < threadCount; width *= 2) {
+        workers.clear();
+        for (size_t t = 0; t + width < threadCount; t += 2 * width) {
+            size_t mid = bounds[t + width];
+            size_t last = bounds[min(t + 2 * width, threadCount)];
+            size_t first = bounds[t];
+            workers.push_back(thread([&, first, mid, last]() {
+                inplace_merge(index.byTitle.begin() + first, index.byTitle.begin() + mid,
+                        index.byTitle.begin() + last, titleLess);
+            }));
+        }
+        for (size_t t = 0; t < workers.size(); ++t) {
+            workers[t].join();
+        }
+    }
+
+    // stitch the chunk lists together; only the first entry of each
+    // chunk's list needs re-encoding relative to the previous chunk
+    vector<uint32_t> allGrams;
+    for (size_t c = 0; c < chunkCount; ++c) {
+        allGrams.insert(allGrams.end(), chunks[c].grams.begin(), chunks[c].grams.end());
+    }
+    sort(allGrams.begin(), allGrams.end());
+    allGrams.erase(unique(allGrams.begin(), allGrams.end()), allGrams.end());
+
+    index.grams = allGrams;
+    index.postingCount.reserve(allGrams.size());
+    index.postingStart.reserve(allGrams.size() + 1);
+    vector<size_t> cursor(chunkCount, 0);
+    for (size_t g = 0; g < allGrams.size(); ++g) {
+        index.postingStart.push_back(index.postings.size());
+        uint32_t count = 0;
+        uint32_t last = 0;
+        for (size_t c = 0; c < chunkCount; ++c) {
+            GramChunk& chunk = chunks[c];
+            size_t k = cursor[c];
+            if (k >= chunk.grams.size() || chunk.grams[k] != allGrams[g]) {
+                continue;
+            }
+            const uint8_t* p = chunk.postings.data() + chunk.starts[k];
+            const uint8_t* end = chunk.postings.data() + chunk.starts[k + 1];
+            uint32_t first;
+            p = readVarint(p, first);
+            appendVarint(index.postings, first - last);
+            index.postings.insert(index.postings.end(), p, end);
+            last = chunk.lasts[k];
+            count += chunk.counts[k];
+            ++cursor[c];
+        }
+        index.postingCount.push_back(count);
+    }
+    index.postingStart.push_back(index.postings.size());
+    index.postings.shrink_to_fit();
+    return index;
+}
+
+/**
+ * @return bytes held by the index structures
+ */
+size_t titleIndexBytes(const TitleIndex& index) {
+    return index.byTitle.capacity() * sizeof(uint32_t)
+            + index.grams.capacity() * sizeof(uint32_t)
+            + index.postingCount.capacity() * sizeof(uint32_t)
+            + index.postingStart.capacity() * sizeof(uint64_t)
+            + index.postings.capacity();
+}
+
+/**
+ * Print how much memory each part of the index uses
+ */
+void reportTitleIndex(const TitleIndex& index) {
+    uint64_t postingTotal = 0;
+    for (size_t g = 0; g < index.postingCount.size(); ++g) {
+        postingTotal += index.postingCount[g];
+    }
+    cout << "title index: " << titleIndexBytes(index) / (1024.0 * 1024.0) << " MB ("
+            << "prefix " << index.byTitle.size() * sizeof(uint32_t) / (1024.0 * 1024.0) << " MB, "
+            << index.grams.size() << " trigrams, "
+            << postingTotal << " postings in " << index.postings.size() / (1024.0 * 1024.0) << " MB, "
+            << (postingTotal ? index.postings.size() * 1.0 / postingTotal : 0.0) << " bytes/posting)"
+            << endl;
+}
+
+/**
+ * Find bids whose title starts with the given text
+ *
+ * @param limit maximum number of positions to return
+ * @return bid positions in title order
+ */
+vector<uint32_t> prefixSearch(const TitleIndex& index, const pmr::vector<Bid>& bids, const string& text,
+        size_t limit) {
+    string prefix = collationPrefix(text);
+    vector<uint32_t>::const_iterator it = lower_bound(index.byTitle.begin(), index.byTitle.end(),
+            prefix, [&bids](uint32_t i, const string& p) {
+                return sortTitle(bids[i]).compare(p) < 0;
+            });
+    vector<uint32_t> matches;
+    for (; it != index.byTitle.end() && matches.size() < limit; ++it) {
+        if (sortTitle(bids[*it]).compare(0, prefix.size(), prefix) != 0) {
+            break;
+        }
+        matches.push_back(*it);
+    }
+    return matches;
+}
+
+/**
+ * Find bids whose title contains the given text anywhere
+ *
+ * @param limit maximum number of positions to return
+ * @return bid positions in load order
+ */
+vector<uint32_t> substringSearch(const TitleIndex& index, const pmr::vector<Bid>& bids, const string& text,
+        size_t limit) {
+    string needle = collationPrefix(text);
+    vector<uint32_t> matches;
+
+    // too short for a trigram: fall back to scanning every title
+    if (needle.size() < 3) {
+        for (size_t i = 0; i < bids.size() && matches.size() < limit; ++i) {
+            if (searchText(bids[i]).find(needle) != string_view::npos) {
+                matches.push_back((uint32_t) i);
+            }
+        }
+        return matches;
+    }
+
+    // look up every trigram of the query, rarest first
+    vector<uint32_t> grams;
+    collectGrams(needle, grams);
+    vector<pair<uint32_t, size_t> > lists;
+    for (size_t g = 0; g < grams.size(); ++g) {
+        vector<uint32_t>::const_iterator it = lower_bound(index.grams.begin(), index.grams.end(), grams[g]);
+        if (it == index.grams.end() || *it != grams[g]) {
+            return matches;
+        }
+        size_t slot = it - index.grams.begin();
+        lists.push_back(make_pair(index.postingCount[slot], slot));
+    }
+    sort(lists.begin(), lists.end());
+
+    // intersect posting lists until the candidate set is small enough to verify
+    vector<uint32_t> candidates;
+    for (size_t l = 0; l < lists.size(); ++l) {
+        if (l > 0 && candidates.size() <= 256) {
+            break;
+        }
+        size_t slot = lists[l].second;
+        const uint8_t* p = index.postings.data() + index.postingStart[slot];
+        const uint8_t* end = index.postings.data() + index.postingStart[slot + 1];
+        vector<uint32_t> next;
+        uint32_t position = 0;
+        size_t c = 0;
+        while (p < end && (l == 0 || c < candidates.size())) {
+            uint32_t delta;
+            p = readVarint(p, delta);
+            position += delta;
+            if (l == 0) {
+                next.push_back(position);
+                continue;
+            }
+            while (c < candidates.size() && candidates[c] < position) {
+                ++c;
+            }
+            if (c < candidates.size() && candidates[c] == position) {
+                next.push_back(position);
+            }
+        }
+        candidates.swap(next);
+    }
+
+    for (size_t c = 0; c < candidates.size() && matches.size() < limit; ++c) {
+        if (searchText(bids[candidates[c]]).find(needle) != string_view::npos) {
+            matches.push_back(candidates[c]);
+        }
+    }
+    return matches;
+}
+
+/**
+ * Prompt for search text and print prefix and substring matches
+ *
+ * @param index index built over bids
+ * @param bids the bids the index refers to
+ */
+void searchTitles(const TitleIndex& index, const pmr::vector<Bid>& bids) {
+    cout << "Enter search text: ";
+    cin.ignore();
+    string text;
+    getline(cin, text);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<uint32_t> prefixMatches = prefixSearch(index, bids, text, 20);
+    double prefixMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    vector<uint32_t> substringMatches = substringSearch(index, bids, text, 20);
+    double substringMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    cout << "Titles starting with \"" << text << "\" (" << prefixMs << " ms):" << endl;
+    for (size_t i = 0; i < prefixMatches.size(); ++i) {
+        displayBid(bids[prefixMatches[i]]);
+    }
+    cout << "Titles containing \"" << text << "\" (" << substringMs << " ms):" << endl;
+    for (size_t i = 0; i < substringMatches.size(); ++i) {
+        displayBid(bids[substringMatches[i]]);
+    }
+    cout << endl;
+}
+
+/**
+ *
+ * @param bids Address of the vector<Bid> instance to be partitioned
+ * @param begin Beginning index to partition
+ * @param end Ending index to partition
+ */
+int partition(pmr::vector<Bid>& bids, int begin, int end) {
+	/*
+	 */
+
+	int low = begin;
+	int high = end;
+	bool done = false;
+
+	// selecting middle element as pivot; keep a copy of its key because
+	// the element itself may be swapped away while partitioning
+	pmr::string pivot = sortTitle(bids[low + (high - low) / 2]);
+
+	while(!done) {
+		// while vec[low] < pivot increment 1
+		while(sortTitle(bids[low]).compare(pivot) < 0) {
+			++low;
+		}
+		// while pivot < vec[high] decrement 1
+		while(pivot.compare(sortTitle(bids[high])) < 0) {
+			--high;
+		}
+		// if 1 or no elements is remaining all numbers are partitioned return high
+		if(low >= high) {
+			done = true;
+		} else {
+			// swap the whole bids so keys and fields stay together
+			swap(bids[low], bids[high]);
+
+			++low;
+			--high;
+		}
+	}
+	return high;
+}
+
+
+/**
+ * Perform a quick sort on bid title
+ * Average performance: O(n log(n))
+ * Worst case performance O(n^2))
+ *
+ * @param bids address of the vector<Bid> instance to be sorted
+ * @param begin the beginning index to sort on
+ * @param end the ending index to sort on
+ */
+void quickSort(pmr::vector<Bid>& bids, int begin, int end) {
+	/*
+	 */
+
+	int j = 0;
+	// if there is only one or no element its already sorted
+	if(begin >= end) {
+		return;
+	}
+
+	j = partition(bids, begin, end);
+
+	// sorts recursively
+	quickSort(bids, begin, j);
+	quickSort(bids, j+1, end);
+}
+
+
+/**
+ *
+ * @param bid address of the vector<Bid>
+ *            instance to be sorted
+ */
+void selectionSort(pmr::vector<Bid>& bids) {
+
+	/*
+	 *
+	 */
+
+	// variables declaration
+	int i = 0;
+	int j = 0;
+	int minIndex = 0;
+
+	// outer loop to traverse from first element to the second last element
+	for(i = 0; i < bids.size()-1; ++i ) {
+		minIndex = i;
+		//
+		for(j = i+1; j < bids.size(); j++) {
+			if(sortTitle(bids[j]).compare(sortTitle(bids[minIndex])) < 0) {
+				minIndex = j;
+			}
+		}
+		// swapping the whole bids so keys and fields stay together
+		swap(bids[i], bids[minIndex]);
+	}
+
+}
+
+/**
+ * Drop a load that lives entirely in an arena. Deallocation in a
+ * monotonic arena is a no-op, so destroying the bids is cheap, and the
+ * arena then hands all of its blocks back upstream in one step.
+ *
+ * @param bids container allocated from arena
+ * @param arena the arena to release
+ */
+void releaseBids(pmr::vector<Bid>& bids, pmr::monotonic_buffer_resource& arena) {
+    bids = pmr::vector<Bid>(&arena);
+    arena.release();
+}
+
+/**
+ * Load the file twice, first with every record and string allocated
+ * individually from the heap and then carved from an arena, and report
+ * how long each load (CSV parsing included) and its teardown take
+ *
+ * @param csvPath the path to the CSV file to load
+ */
+void compareArena(string csvPath) {
+    const char* names[] = { "heap", "arena" };
+    for (int useArena = 0; useArena < 2; ++useArena) {
+        pmr::monotonic_buffer_resource arena(ARENA_BLOCK, &gBidMemory);
+        pmr::memory_resource* memory = &gBidMemory;
+        if (useArena) {
+            memory = &arena;
+        }
+        uint64_t allocations = gBidMemory.counters().allocations.load();
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        pmr::vector<Bid>* bids = new pmr::vector<Bid>(loadBids(csvPath, memory));
+        double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        allocations = gBidMemory.counters().allocations.load() - allocations;
+
+        start = chrono::steady_clock::now();
+        delete bids;
+        arena.release();
+        double teardownSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << names[useArena] << ": load " << loadSeconds << " sec (" << allocations
+                << " bid allocations), teardown " << teardownSeconds << " sec" << endl;
+    }
+}
+
+/**
+ * Heap bytes a string owns beyond its inline (small string) buffer
+ */
+size_t stringHeapBytes(const pmr::string& str) {
+    static const size_t inlineCapacity = pmr::string().capacity();
+    return str.capacity() > inlineCapacity ? str.capacity() + 1 : 0;
+}
+
+/**
+ * Print memory used by each component of the bid pipeline, followed by
+ * the allocation counts of every phase run so far
+ *
+ * @param bids the loaded bids
+ * @param index the title index built over them
+ */
+void reportMemory(const pmr::vector<Bid>& bids, const TitleIndex& index) {
+    size_t recordBytes = bids.capacity() * sizeof(Bid);
+    size_t stringBytes = 0;
+    for (size_t i = 0; i < bids.size(); ++i) {
+        stringBytes += stringHeapBytes(bids[i].bidId) + stringHeapBytes(bids[i].title)
+                + stringHeapBytes(bids[i].titleKey) + stringHeapBytes(bids[i].fund);
+    }
+    const double MB = 1024.0 * 1024.0;
+
+    cout << "Memory report:" << endl;
+    cout << "  record array   : " << recordBytes / MB << " MB (" << bids.size() << " x "
+            << sizeof(Bid) << " bytes, capacity " << bids.capacity() << ")" << endl;
+    cout << "  string heap    : " << stringBytes / MB << " MB" << endl;
+    cout << "  parser buffers : " << gParserBytes / MB << " MB (held during the last load)" << endl;
+    cout << "  title index    : " << titleIndexBytes(index) / MB << " MB" << endl;
+    cout << "  bid allocator  : " << gBidMemory.counters().bytesInUse.load() / MB << " MB in use, "
+            << gBidMemory.counters().allocations.load() << " allocations" << endl;
+    cout << "  process heap   : " << gHeapCounters.bytesInUse.load() / MB << " MB in use, "
+            << gHeapCounters.allocations.load() << " allocations" << endl;
+    cout << "  RSS            : " << currentRssKb() / 1024.0 << " MB now, "
+            << peakRssKb() / 1024.0 << " MB peak" << endl;
+
+    if (!gMemoryPhases.empty()) {
+        cout << "  " << left << setw(16) << "phase" << right << setw(10) << "seconds" << setw(14)
+                << "heap allocs" << setw(10) << "heap MB" << setw(14) << "heap peak MB" << setw(12)
+                << "bid allocs" << setw(10) << "bid MB" << setw(13) << "peak RSS MB" << endl;
+    }
+    streamsize precision = cout.precision();
+    for (size_t i = 0; i < gMemoryPhases.size(); ++i) {
+        const MemoryPhase& phase = gMemoryPhases[i];
+        cout << "  " << left << setw(16) << phase.name << right << fixed << setprecision(3)
+                << setw(10) << phase.seconds << setw(14) << phase.heapAllocations
+                << setw(10) << phase.heapBytes / MB << setw(14) << phase.heapPeak / MB
+                << setw(12) << phase.bidAllocations << setw(10) << phase.bidBytes / MB
+                << setw(13) << phase.peakRssKb / 1024.0 << defaultfloat << endl;
+    }
+    cout.precision(precision);
+    cout << endl;
+}
+
+/**
+ * Time quickSort under every collation on a copy of the bids, together
+ * with the one-off cost of building the sort keys, so the price of
+ * case/accent-insensitive ordering can be compared with byte order
+ *
+ * @param bids the bids to sort copies of
+ */
+void compareCollations(const pmr::vector<Bid>& bids) {
+    const Collation collations[] = { COLLATE_BYTES, COLLATE_CASE, COLLATE_ACCENTS };
+    Collation active = gCollation;
+    double byteSeconds = 0.0;
+
+    for (int c = 0; c < 3; ++c) {
+        pmr::vector<Bid> copy = bids;
+        gCollation = collations[c];
+
+        clock_t ticks = clock();
+        applyCollation(copy);
+        double keySeconds = (clock() - ticks) * 1.0 / CLOCKS_PER_SEC;
+
+        ticks = clock();
+        quickSort(copy, 0, copy.size() - 1);
+        double sortSeconds = (clock() - ticks) * 1.0 / CLOCKS_PER_SEC;
+
+        if (c == 0) {
+            byteSeconds = sortSeconds;
+        }
+        cout << collationName(collations[c]) << ": keys " << keySeconds << " sec, sort "
+                << sortSeconds << " sec";
+        if (c > 0 && byteSeconds > 0.0) {
+            cout << " (" << (keySeconds + sortSeconds) / byteSeconds << "x byte order)";
+        }
+        cout << endl;
+    }
+    gCollation = active;
+}
+
+/**
+ * Simple C function to convert a string to a double
+ * after stripping out unwanted char
+ *
+ * @param ch The character to strip out
+ */
+double strToDouble(string str, char ch) {
+    str.erase(remove(str.begin(), str.end(), ch), str.end());
+    return atof(str.c_str());
+}
+
+//============================================================================
+// Batch mode: load -> dedup -> sort -> top-K -> write, without prompts
+//============================================================================
+
+// the field a batch run orders bids by
+enum BatchKey {
+    BATCH_TITLE,   // sortTitle(), ascending
+    BATCH_AMOUNT,  // amount, descending, as TOPK on the server
+    BATCH_ID       // bidId, ascending
+};
+
+/**
+ * Options of one batch run, taken from the command line
+ */
+struct BatchOptions {
+    string csvPath;
+    string outPath;
+    string reportPath;  // JSON report; empty writes it to stdout
+    BatchKey key;
+    size_t top;         // 0 keeps every bid
+    bool dedup;
+    bool verify;        // load the output again and compare it
+
+    BatchOptions() : key(BATCH_TITLE), top(0), dedup(true), verify(false) {
+    }
+};
+
+/**
+ * Rows and bytes that went through one stage; its time and memory are
+ * kept in the MemoryPhase recorded alongside it
+ */
+struct BatchStage {
+    size_t rowsIn;
+    size_t rowsOut;
+    uint64_t bytes;  // file bytes read or written, 0 for in-memory stages
+};
+
+/**
+ * Size of a file in bytes, 0 if it can't be examined
+ */
+uint64_t fileBytes(const string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return 0;
+    }
+    return info.st_size;
+}
+
+/**
+ * Keep the first bid of every bidId, preserving file order
+ *
+ * @param bids the bids to deduplicate in place
+ */
+void dedupBids(pmr::vector<Bid>& bids) {
+    // mark first, then compact: the views point into the bids being moved
+    vector<char> keep(bids.size());
+    {
+        // the set's nodes come from one scratch arena, not one new each
+        pmr::monotonic_buffer_resource scratch(ARENA_BLOCK, &gBidMemory);
+        pmr::unordered_set<string_view> seen(&scratch);
+        seen.reserve(bids.size());
+        for (size_t i = 0; i < bids.size(); ++i) {
+            keep[i] = seen.insert(string_view(bids[i].bidId)).second;
+        }
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < bids.size(); ++i) {
+        if (keep[i]) {
+            if (kept != i) {
+                bids[kept] = std::move(bids[i]);
+            }
+            ++kept;
+        }
+    }
+    bids.erase(bids.begin() + kept, bids.end());
+}
+
+/**
+ * Order bids by the batch key, ties broken by bidId so every run of the
+ * same input writes the same file. With a top count only that many bids
+ * are put in order and the rest are dropped.
+ *
+ * @param bids the bids to sort in place
+ * @param key field to order by
+ * @param top number of bids to keep, 0 for all
+ */
+void sortBids(pmr::vector<Bid>& bids, BatchKey key, size_t top) {
+    auto before = [key](const Bid& a, const Bid& b) {
+        int order = 0;
+        if (key == BATCH_TITLE) {
+            order = sortTitle(a).compare(sortTitle(b));
+        } else if (key == BATCH_AMOUNT) {
+            order = a.amount > b.amount ? -1 : (a.amount < b.amount ? 1 : 0);
+        }
+        if (order == 0) {
+            order = a.bidId.compare(b.bidId);
+        }
+        return order < 0;
+    };
+    if (top > 0 && top < bids.size()) {
+        partial_sort(bids.begin(), bids.begin() + top, bids.end(), before);
+    } else {
+        sort(bids.begin(), bids.end(), before);
+    }
+}
+
+/**
+ * Whether a field is one whole quoted CSV field, as both loaders keep
+ * them: a quote at each end and every quote between them doubled
+ */
+bool isQuotedCsvField(string_view field) {
+    if (field.size() < 2 || field.front() != '"' || field.back() != '"') {
+        return false;
+    }
+    for (size_t i = 1; i + 1 < field.size(); ++i) {
+        if (field[i] == '"') {
+            if (i + 2 >= field.size() || field[i + 1] != '"') {
+                return false;
+            }
+            ++i;
+        }
+    }
+    return true;
+}
+
+/**
+ * Append one CSV field, quoting it when it holds a separator or a quote.
+ * A field that is already quoted goes out as it is, so that it loads
+ * back unchanged rather than gaining a layer of quotes.
+ */
+void appendCsvField(string& out, string_view field) {
+    if (isQuotedCsvField(field) || field.find_first_of(",\"\r\n") == string_view::npos) {
+        out.append(field);
+        return;
+    }
+    out.push_back('"');
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] == '"') {
+            out.push_back('"');
+        }
+        out.push_back(field[i]);
+    }
+    out.push_back('"');
+}
+
+/**
+ * Write bids as CSV in the column layout loadBids reads, leaving the
+ * columns a Bid doesn't keep empty, so the output can be loaded again
+ *
+ * @param bids the bids to write, in order
+ * @param outPath file to create or replace
+ * @return bytes written, or -1 if the file couldn't be written
+ */
+long long writeBids(const pmr::vector<Bid>& bids, const string& outPath) {
+    FILE* out = fopen(outPath.c_str(), "w");
+    if (out == NULL) {
+        return -1;
+    }
+    string buffer = "ArticleTitle,ArticleID,Department,CloseDate,WinningBid,InventoryID,VehicleID,ReceiptNumber,Fund\n";
+    long long written = 0;
+    bool ok = true;
+    char amount[32];
+    for (size_t i = 0; i < bids.size() && ok; ++i) {
+        appendCsvField(buffer, bids[i].title);
+        buffer.push_back(',');
+        appendCsvField(buffer, bids[i].bidId);
+        snprintf(amount, sizeof(amount), ",,,$%.2f,,,,", bids[i].amount);
+        buffer.append(amount);
+        appendCsvField(buffer, bids[i].fund);
+        buffer.push_back('\n');
+
+        // flush in large chunks rather than once per row
+        if (buffer.size() >= (1 << 16) || i + 1 == bids.size()) {
+            ok = fwrite(buffer.data(), 1, buffer.size(), out) == buffer.size();
+            written += buffer.size();
+            buffer.clear();
+        }
+    }
+    if (bids.empty()) {
+        ok = fwrite(buffer.data(), 1, buffer.size(), out) == buffer.size();
+        written += buffer.size();
+    }
+    if (fclose(out) != 0) {
+        ok = false;
+    }
+    return ok ? written : -1;
+}
+
+/**
+ * Compare bids with the same bids written out and loaded again
+ *
+ * @return index of the first row that differs, or string::npos
+ */
+size_t verifyBids(const pmr::vector<Bid>& written, const pmr::vector<Bid>& reloaded) {
+    for (size_t i = 0; i < written.size(); ++i) {
+        if (i >= reloaded.size() || reloaded[i].title != written[i].title
+                || reloaded[i].bidId != written[i].bidId || reloaded[i].fund != written[i].fund) {
+            return i;
+        }
+    }
+    return reloaded.size() == written.size() ? string::npos : written.size();
+}
+
+/**
+ * Quote a string for a JSON document
+ */
+string jsonString(string_view text) {
+    string out = "\"";
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out.append(escaped);
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+    return out;
+}
+
+/**
+ * Write the JSON report of a batch run: settings, then each stage's wall
+ * time, row and byte throughput and the memory counters of its phase
+ *
+ * @param out stream to write to
+ * @param options the settings the run used
+ * @param stages rows and bytes of each stage
+ * @param phases time and memory of each stage, in the same order
+ * @param totalSeconds wall time of the whole pipeline
+ */
+void writeBatchReport(ostream& out, const BatchOptions& options, const vector<BatchStage>& stages,
+        const vector<MemoryPhase>& phases, double totalSeconds) {
+    const char* keys[] = { "title", "amount", "id" };
+    streamsize precision = out.precision();
+    out << setprecision(6);
+
+    out << "{" << endl;
+    out << "  \"input\": " << jsonString(options.csvPath) << "," << endl;
+    out << "  \"output\": " << jsonString(options.outPath) << "," << endl;
+    out << "  \"parser\": \"" << (gCsvParser == CSV_SIMD ? "simd" : "classic") << "\"," << endl;
+    out << "  \"collation\": \"" << collationName(gCollation) << "\"," << endl;
+    out << "  \"sort_key\": \"" << keys[options.key] << "\"," << endl;
+    out << "  \"dedup\": " << (options.dedup ? "true" : "false") << "," << endl;
+    out << "  \"top\": " << options.top << "," << endl;
+    out << "  \"stages\": [" << endl;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const BatchStage& stage = stages[i];
+        const MemoryPhase& phase = phases[i];
+        double seconds = phase.seconds > 0.0 ? phase.seconds : 1e-9;
+        out << "    {\"name\": " << jsonString(phase.name)
+                << ", \"seconds\": " << phase.seconds
+                << ", \"rows_in\": " << stage.rowsIn
+                << ", \"rows_out\": " << stage.rowsOut
+                << ", \"rows_per_sec\": " << stage.rowsIn / seconds
+                << ", \"bytes\": " << stage.bytes
+                << ", \"mb_per_sec\": " << stage.bytes / seconds / (1024.0 * 1024.0)
+                << ", \"heap_allocations\": " << phase.heapAllocations
+                << ", \"heap_bytes\": " << phase.heapBytes
+                << ", \"heap_peak_bytes\": " << phase.heapPeak
+                << ", \"bid_allocations\": " << phase.bidAllocations
+                << ", \"bid_bytes\": " << phase.bidBytes
+                << ", \"peak_rss_kb\": " << phase.peakRssKb << "}"
+                << (i + 1 < stages.size() ? "," : "") << endl;
+    }
+    out << "  ]," << endl;
+    out << "  \"total_seconds\": " << totalSeconds << "," << endl;
+    out << "  \"peak_rss_kb\": " << peakRssKb() << endl;
+    out << "}" << endl;
+
+    out.precision(precision);
+}
+
+/**
+ * Run the load -> dedup -> sort -> top-K -> write pipeline with no
+ * prompts. Progress and the memory report go to stderr, so stdout
+ * carries nothing but the JSON report when no report file is given.
+ *
+ * @param options the pipeline settings
+ * @return process exit code
+ */
+int runBatch(const BatchOptions& options) {
+    // route everything the shared code prints away from the report
+    streambuf* stdoutBuffer = cout.rdbuf(cerr.rdbuf());
+    ostream report(stdoutBuffer);
+
+    pmr::monotonic_buffer_resource arena(ARENA_BLOCK, &gBidMemory);
+    pmr::vector<Bid> bids(&arena);
+    vector<BatchStage> stages;
+    size_t firstPhase = gMemoryPhases.size();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int status = 0;
+
+    try {
+        BatchStage stage = { 0, 0, fileBytes(options.csvPath) };
+        {
+            MemoryPhaseScope phase("load");
+            bids = loadBids(options.csvPath, &arena);
+        }
+        stage.rowsOut = bids.size();
+        stage.rowsIn = bids.size();
+        stages.push_back(stage);
+    } catch (csv::Error& e) {
+        cerr << e.what() << endl;
+        cout.rdbuf(stdoutBuffer);
+        return 1;
+    }
+
+    if (options.dedup) {
+        BatchStage stage = { bids.size(), 0, 0 };
+        {
+            MemoryPhaseScope phase("dedup");
+            dedupBids(bids);
+        }
+        stage.rowsOut = bids.size();
+        stages.push_back(stage);
+    }
+
+    {
+        BatchStage stage = { bids.size(), 0, 0 };
+        {
+            MemoryPhaseScope phase(options.top > 0 ? "sort top-k" : "sort");
+            sortBids(bids, options.key, options.top);
+            if (options.top > 0 && options.top < bids.size()) {
+                bids.erase(bids.begin() + options.top, bids.end());
+            }
+        }
+        stage.rowsOut = bids.size();
+        stages.push_back(stage);
+    }
+
+    {
+        BatchStage stage = { bids.size(), bids.size(), 0 };
+        long long written;
+        {
+            MemoryPhaseScope phase("write");
+            written = writeBids(bids, options.outPath);
+        }
+        if (written < 0) {
+            cerr << "Failed to write " << options.outPath << endl;
+            status = 1;
+        } else {
+            stage.bytes = written;
+        }
+        stages.push_back(stage);
+    }
+
+    if (options.verify && status == 0) {
+        BatchStage stage = { bids.size(), 0, fileBytes(options.outPath) };
+        {
+            MemoryPhaseScope phase("verify");
+            pmr::monotonic_buffer_resource verifyArena(ARENA_BLOCK, &gBidMemory);
+            try {
+                pmr::vector<Bid> reloaded = loadBids(options.outPath, &verifyArena);
+                stage.rowsOut = reloaded.size();
+                size_t mismatch = verifyBids(bids, reloaded);
+                if (mismatch != string::npos) {
+                    cerr << "Output row " << mismatch << " doesn't load back as written" << endl;
+                    status = 1;
+                }
+            } catch (csv::Error& e) {
+                cerr << e.what() << endl;
+                status = 1;
+            }
+        }
+        stages.push_back(stage);
+    }
+
+    double totalSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    vector<MemoryPhase> phases(gMemoryPhases.begin() + firstPhase, gMemoryPhases.end());
+
+    TitleIndex noIndex;
+    reportMemory(bids, noIndex);
+    cout.rdbuf(stdoutBuffer);
+
+    if (options.reportPath.empty()) {
+        writeBatchReport(report, options, stages, phases, totalSeconds);
+    } else {
+        ostringstream json;
+        writeBatchReport(json, options, stages, phases, totalSeconds);
+        FILE* out = fopen(options.reportPath.c_str(), "w");
+        if (out == NULL || fwrite(json.str().data(), 1, json.str().size(), out) != json.str().size()) {
+            cerr << "Failed to write " << options.reportPath << endl;
+            status = 1;
+        }
+        if (out != NULL && fclose(out) != 0) {
+            status = 1;
+        }
+    }
+    return status;
+}
+
+/**
+ * Parse the arguments of --batch <csv> <out> [--sort=title|amount|id]
+ * [--top=K] [--no-dedup] [--verify] [--report=path]
+ *
+ * @return false, after printing why, if an argument isn't understood
+ */
+bool parseBatchOptions(int argc, char* argv[], BatchOptions& options) {
+    if (argc < 4) {
+        cerr << "usage: " << argv[0] << " --batch <csv> <out.csv> [--sort=title|amount|id]"
+                << " [--top=K] [--no-dedup] [--verify] [--report=report.json]" << endl;
+        return false;
+    }
+    options.csvPath = argv[2];
+    options.outPath = argv[3];
+    for (int i = 4; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--sort=title") {
+            options.key = BATCH_TITLE;
+        } else if (arg == "--sort=amount") {
+            options.key = BATCH_AMOUNT;
+        } else if (arg == "--sort=id") {
+            options.key = BATCH_ID;
+        } else if (arg.compare(0, 6, "--top=") == 0 && arg.size() > 6
+                && arg.find_first_not_of("0123456789", 6) == string::npos) {
+            options.top = strtoull(arg.c_str() + 6, NULL, 10);
+        } else if (arg == "--no-dedup") {
+            options.dedup = false;
+        } else if (arg == "--verify") {
+            options.verify = true;
+        } else if (arg.compare(0, 9, "--report=") == 0) {
+            options.reportPath = arg.substr(9);
+        } else {
+            cerr << "Unknown batch option " << arg << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//============================================================================
+// Query server: a long-running, read-only view of one loaded bid set
 //============================================================================
 
-// forward declarations
-double strToDouble(string str, char ch);
+/**
+ * Running totals for all bids that share one fund
+ */
+struct FundTotal {
+    long count;
+    double total;
+    double min;
+    double max;
+    FundTotal() {
+        count = 0;
+        total = 0.0;
+        min = 0.0;
+        max = 0.0;
+    }
+};
 
-// define a structure to hold bid information
-struct Bid {
-    string bidId; // unique identifier
-    string title;
-    string fund;
-    double amount;
-    Bid() {
-        amount = 0.0;
+/**
+ * Immutable, fully indexed copy of a bid set. Queries hold a shared_ptr
+ * to one snapshot for their whole lifetime; a reload builds a new
+ * snapshot off to the side and swaps the pointer, so readers never lock
+ * and never observe a half-loaded set.
+ */
+struct BidSnapshot {
+    pmr::monotonic_buffer_resource arena;  // holds bids and their strings
+    pmr::vector<Bid> bids;                 // records in file order
+    unordered_map<string, size_t> byId;    // bidId -> index into bids
+    TitleIndex titles;                     // prefix and substring search
+    vector<size_t> byAmount;               // indices ordered by descending amount
+    map<string, FundTotal> funds;          // aggregates keyed by fund name
+    string csvPath;
+    unsigned long version;
+
+    // the last reader to drop a snapshot releases its whole load at once
+    BidSnapshot() : arena(ARENA_BLOCK, &gBidMemory), bids(&arena) {
     }
 };
 
+/**
+ * Log-linear latency histogram that any number of threads may update.
+ * Every power of two is split into 16 buckets, so percentiles are
+ * reported to within about 6% of the exact value.
+ */
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int BUCKETS = 64 << SUB_BITS;
 
-//============================================================================
+    LatencyHistogram() {
+        for (int i = 0; i < BUCKETS; ++i) {
+            counts[i].store(0);
+        }
+        total.store(0);
+    }
+
+    void record(uint64_t nanos) {
+        counts[bucketFor(nanos)].fetch_add(1, memory_order_relaxed);
+        total.fetch_add(1, memory_order_relaxed);
+    }
+
+    uint64_t count() const {
+        return total.load(memory_order_relaxed);
+    }
+
+    /**
+     * @param p fraction between 0 and 1 (0.99 for p99)
+     * @return upper bound of the bucket holding that rank, in nanoseconds
+     */
+    uint64_t percentile(double p) const {
+        uint64_t n = count();
+        if (n == 0) {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(p * n);
+        if (rank >= n) {
+            rank = n - 1;
+        }
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i].load(memory_order_relaxed);
+            if (seen > rank) {
+                return bucketUpper(i);
+            }
+        }
+        return bucketUpper(BUCKETS - 1);
+    }
+
+private:
+    static int bucketFor(uint64_t v) {
+        if (v < (1u << SUB_BITS)) {
+            return (int) v;
+        }
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - SUB_BITS;
+        return ((shift + 1) << SUB_BITS) + (int) ((v >> shift) & ((1 << SUB_BITS) - 1));
+    }
+
+    static uint64_t bucketUpper(int i) {
+        if (i < (1 << SUB_BITS)) {
+            return (uint64_t) i;
+        }
+        int shift = (i >> SUB_BITS) - 1;
+        uint64_t lower = (uint64_t) ((1 << SUB_BITS) + (i & ((1 << SUB_BITS) - 1))) << shift;
+        return lower + ((uint64_t) 1 << shift) - 1;
+    }
+
+    atomic<uint64_t> counts[BUCKETS];
+    atomic<uint64_t> total;
+};
+
+// current snapshot; only ever touched through atomic_load/atomic_store
+shared_ptr<const BidSnapshot> gSnapshot;
+// serialises reloads against each other, never taken by readers
+mutex gReloadMutex;
+// server-side latency of read queries
+LatencyHistogram gLatency;
+// set from the signal handler to stop the worker threads
+volatile sig_atomic_t gServerStop = 0;
 
 /**
- * Display the bid information to the console (std::out)
+ * Format a bid the same way displayBid() prints it
  *
  * @param bid struct containing the bid info
+ * @return one line of text, without the trailing newline
  */
-void displayBid(Bid bid) {
-    cout << bid.bidId << ": " << bid.title << " | " << bid.amount << " | "
-            << bid.fund << endl;
-    return;
+string formatBid(const Bid& bid) {
+    ostringstream out;
+    out << bid.bidId << ": " << bid.title << " | " << bid.amount << " | "
+            << bid.fund;
+    return out.str();
 }
 
 /**
- * Prompt user for bid information using console (std::in)
+ * Load a CSV file and build every index the server answers from
  *
- * @return Bid struct containing the bid info
+ * @param csvPath the path to the CSV file to load
+ * @param version number reported by STATS for this snapshot
+ * @return the new snapshot, ready to be published
  */
-Bid getBid() {
-    Bid bid;
+shared_ptr<const BidSnapshot> buildSnapshot(string csvPath, unsigned long version) {
+    shared_ptr<BidSnapshot> snap = make_shared<BidSnapshot>();
+    snap->csvPath = csvPath;
+    snap->version = version;
+    snap->bids = loadBids(csvPath, &snap->arena);
 
-    cout << "Enter Id: ";
-    cin.ignore();
-    getline(cin, bid.bidId);
+    const pmr::vector<Bid>& bids = snap->bids;
+    snap->byId.reserve(bids.size());
+    snap->byAmount.resize(bids.size());
 
-    cout << "Enter title: ";
-    getline(cin, bid.title);
+    for (size_t i = 0; i < bids.size(); ++i) {
+        snap->byId.emplace(bids[i].bidId, i);
+        snap->byAmount[i] = i;
 
-    cout << "Enter fund: ";
-    cin >> bid.fund;
+        FundTotal& fund = snap->funds[string(bids[i].fund)];
+        if (fund.count == 0 || bids[i].amount < fund.min) {
+            fund.min = bids[i].amount;
+        }
+        if (fund.count == 0 || bids[i].amount > fund.max) {
+            fund.max = bids[i].amount;
+        }
+        fund.total += bids[i].amount;
+        ++fund.count;
+    }
 
-    cout << "Enter amount: ";
-    cin.ignore();
-    string strAmount;
-    getline(cin, strAmount);
-    bid.amount = strToDouble(strAmount, '$');
+    snap->titles = buildTitleIndex(bids);
+    stable_sort(snap->byAmount.begin(), snap->byAmount.end(), [&bids](size_t a, size_t b) {
+        return bids[a].amount > bids[b].amount;
+    });
 
-    return bid;
+    return snap;
 }
 
 /**
- * Load a CSV file containing bids into a container
+ * Answer one request line against the current snapshot
  *
- * @param csvPath the path to the CSV file to load
- * @return a container holding all the bids read
+ * Requests, one per line:
+ *   GET <bidId>
+ *   PREFIX <limit> <title prefix>
+ *   SEARCH <limit> <title substring>
+ *   TOPK <k>
+ *   FUNDS
+ *   STATS
+ *   RELOAD [csvPath]
+ *
+ * Replies start with "OK <n>" followed by n lines, or a single "ERR" line.
+ *
+ * @param line the request without its newline
+ * @param isRead set to false for requests that must not count towards latency
+ * @return the complete reply text
  */
-vector<Bid> loadBids(string csvPath) {
-    cout << "Loading CSV file " << csvPath << endl;
+string handleQuery(const string& line, bool& isRead) {
+    istringstream in(line);
+    string command;
+    in >> command;
+    isRead = true;
 
-    // Define a vector data structure to hold a collection of bids.
-    vector<Bid> bids;
+    // pin one snapshot for the whole request, even if a reload lands meanwhile
+    shared_ptr<const BidSnapshot> snap = atomic_load(&gSnapshot);
+    ostringstream out;
 
-    // initialize the CSV Parser using the given path
-    csv::Parser file = csv::Parser(csvPath);
+    if (command == "GET") {
+        string bidId;
+        in >> bidId;
+        unordered_map<string, size_t>::const_iterator it = snap->byId.find(bidId);
+        if (it == snap->byId.end()) {
+            return "ERR no bid " + bidId + "\n";
+        }
+        out << "OK 1\n" << formatBid(snap->bids[it->second]) << "\n";
 
-    try {
-        // loop to read rows of a CSV file
-        for (int i = 0; i < file.rowCount(); i++) {
+    } else if (command == "PREFIX" || command == "SEARCH") {
+        size_t limit = 0;
+        string text;
+        in >> limit;
+        in >> ws;
+        getline(in, text);
 
-            // Create a data structure and add to the collection of bids
-            Bid bid;
-            bid.bidId = file[i][1];
-            bid.title = file[i][0];
-            bid.fund = file[i][8];
-            bid.amount = strToDouble(file[i][4], '$');
+        vector<uint32_t> matches = command == "PREFIX"
+                ? prefixSearch(snap->titles, snap->bids, text, limit)
+                : substringSearch(snap->titles, snap->bids, text, limit);
+        out << "OK " << matches.size() << "\n";
+        for (size_t i = 0; i < matches.size(); ++i) {
+            out << formatBid(snap->bids[matches[i]]) << "\n";
+        }
 
-            // push this bid to the end
-            bids.push_back(bid);
+    } else if (command == "TOPK") {
+        size_t k = 0;
+        in >> k;
+        k = min(k, snap->byAmount.size());
+        out << "OK " << k << "\n";
+        for (size_t i = 0; i < k; ++i) {
+            out << formatBid(snap->bids[snap->byAmount[i]]) << "\n";
         }
-    } catch (csv::Error &e) {
-        std::cerr << e.what() << std::endl;
+
+    } else if (command == "FUNDS") {
+        out << "OK " << snap->funds.size() << "\n";
+        for (map<string, FundTotal>::const_iterator it = snap->funds.begin(); it != snap->funds.end(); ++it) {
+            const FundTotal& fund = it->second;
+            out << it->first << " | " << fund.count << " | " << fund.total << " | " << fund.min
+                    << " | " << fund.max << " | " << fund.total / fund.count << "\n";
+        }
+
+    } else if (command == "STATS") {
+        isRead = false;
+        out << "OK 1\n" << "version=" << snap->version << " bids=" << snap->bids.size()
+                << " queries=" << gLatency.count()
+                << " p50_us=" << gLatency.percentile(0.50) / 1000.0
+                << " p99_us=" << gLatency.percentile(0.99) / 1000.0
+                << " p999_us=" << gLatency.percentile(0.999) / 1000.0 << "\n";
+
+    } else if (command == "RELOAD") {
+        isRead = false;
+        string csvPath;
+        in >> csvPath;
+
+        // readers keep using the old snapshot until the new one is published
+        lock_guard<mutex> lock(gReloadMutex);
+        shared_ptr<const BidSnapshot> current = atomic_load(&gSnapshot);
+        if (csvPath.empty()) {
+            csvPath = current->csvPath;
+        }
+        shared_ptr<const BidSnapshot> next;
+        try {
+            next = buildSnapshot(csvPath, current->version + 1);
+        } catch (csv::Error &e) {
+            return string("ERR ") + e.what() + "\n";
+        }
+        atomic_store(&gSnapshot, next);
+        out << "OK 1\n" << "version=" << next->version << " bids=" << next->bids.size() << "\n";
+
+    } else {
+        isRead = false;
+        return "ERR unknown command " + command + "\n";
     }
-    return bids;
+    return out.str();
 }
 
 /**
+ * Write the whole buffer to a non-blocking socket
  *
- * @param bids Address of the vector<Bid> instance to be partitioned
- * @param begin Beginning index to partition
- * @param end Ending index to partition
+ * @return false if the peer went away
  */
-int partition(vector<Bid>& bids, int begin, int end) {
-	/*
-	 */
+bool writeAll(int fd, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = write(fd, data.data() + sent, data.size() - sent);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd pfd = { fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, 1000) <= 0) {
+                return false;
+            }
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
 
-	int low = begin;
-	int high = end;
-	string temp = "";
-	int mid = 0;
-	bool done = false;
-	int pivot;
+/**
+ * Per-client state; owned by whichever worker epoll handed it to
+ */
+struct Connection {
+    int fd;
+    string inbox;
+};
 
-	// selecting middle element as pivot
-	pivot = low + (high - low) / 2;
+/**
+ * Drain a readable client socket and answer every complete request in it
+ *
+ * @return false once the connection should be closed
+ */
+bool serveConnection(Connection* conn) {
+    char buffer[4096];
+    bool open = true;
+    for (;;) {
+        ssize_t n = read(conn->fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            conn->inbox.append(buffer, n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                open = false;
+            }
+            break;
+        }
+    }
 
-	while(!done) {
-		// while vec[low] < pivot increment 1
-		while(bids[low].title.compare(bids[pivot].title) < 0) {
-			++low;
-		}
-		// while pivot < vec[high] decrement 1
-		while(bids[pivot].title.compare(bids[high].title) < 0) {
-			--high;
-		}
-		// if 1 or no elements is remaining all numbers are partitioned return high
-		if(low >= high) {
-			done = true;
-		} else {
-			// swap the values in high and low index vectors
-			temp = bids[low].title;
-			bids[low].title = bids[high].title;
-			bids[high].title = temp;
+    size_t pos;
+    while ((pos = conn->inbox.find('\n')) != string::npos) {
+        string line = conn->inbox.substr(0, pos);
+        conn->inbox.erase(0, pos + 1);
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
 
-			++low;
-			--high;
-		}
-	}
-	return high;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        bool isRead;
+        string reply = handleQuery(line, isRead);
+        if (isRead) {
+            gLatency.record(chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now() - start).count());
+        }
+        if (!writeAll(conn->fd, reply)) {
+            return false;
+        }
+    }
+    return open;
 }
 
-
 /**
- * Perform a quick sort on bid title
- * Average performance: O(n log(n))
- * Worst case performance O(n^2))
- *
- * @param bids address of the vector<Bid> instance to be sorted
- * @param begin the beginning index to sort on
- * @param end the ending index to sort on
+ * Worker thread body: every worker waits on the same epoll set, and
+ * one-shot registration guarantees a connection is served by one worker
+ * at a time.
  */
-void quickSort(vector<Bid>& bids, int begin, int end) {
-	/*
-	 */
-
-	int j = 0;
-	// if there is only one or no element its already sorted
-	if(begin >= end) {
-		return;
-	}
+void serverWorker(int epollFd, int listenFd) {
+    epoll_event events[64];
+    while (!gServerStop) {
+        int ready = epoll_wait(epollFd, events, 64, 200);
+        for (int i = 0; i < ready; ++i) {
+            Connection* conn = (Connection*) events[i].data.ptr;
 
-	j = partition(bids, begin, end);
+            if (conn == NULL) {
+                int fd;
+                while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    conn = new Connection();
+                    conn->fd = fd;
+                    epoll_event ev;
+                    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+                    ev.data.ptr = conn;
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+                }
+                continue;
+            }
 
-	// sorts recursively
-	quickSort(bids, begin, j);
-	quickSort(bids, j+1, end);
+            if (serveConnection(conn)) {
+                epoll_event ev;
+                ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+                ev.data.ptr = conn;
+                epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &ev);
+            } else {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, NULL);
+                close(conn->fd);
+                delete conn;
+            }
+        }
+    }
 }
 
+void stopServer(int) {
+    gServerStop = 1;
+}
 
 /**
+ * Load the bids once and answer queries on a Unix socket until SIGINT/SIGTERM
  *
- * @param bid address of the vector<Bid>
- *            instance to be sorted
+ * @param csvPath the path to the CSV file to serve
+ * @param socketPath filesystem path of the Unix socket to listen on
+ * @return process exit code
  */
-void selectionSort(vector<Bid>& bids) {
+int runServer(string csvPath, string socketPath) {
+    try {
+        atomic_store(&gSnapshot, buildSnapshot(csvPath, 1));
+    } catch (csv::Error &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
 
-	/*
-	 *
-	 */
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socketPath.c_str());
+    if (listenFd < 0 || bind(listenFd, (sockaddr*) &addr, sizeof(addr)) < 0
+            || listen(listenFd, SOMAXCONN) < 0) {
+        cerr << "Cannot listen on " << socketPath << ": " << strerror(errno) << endl;
+        return 1;
+    }
 
-	// variables declaration
-	int i = 0;
-	int j = 0;
-	int minIndex = 0;
-	string temp = "";				// holds the variable to be swapped
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = NULL;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
 
-	// outer loop to traverse from first element to the second last element
-	for(i = 0; i < bids.size()-1; ++i ) {
-		minIndex = i;
-		//
-		for(j = i+1; j < bids.size(); j++) {
-			if(bids[j].title.compare(bids[minIndex].title) < 0) {
-				minIndex = j;
-			}
-		}
-		// swapping the variable
-		temp = bids[i].title;
-		bids[i].title = bids[minIndex].title;
-		bids[minIndex].title = temp;
-	}
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    signal(SIGPIPE, SIG_IGN);
+
+    unsigned int threadCount = max(2u, thread::hardware_concurrency());
+    vector<thread> workers;
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        workers.push_back(thread(serverWorker, epollFd, listenFd));
+    }
+    cout << "Serving " << atomic_load(&gSnapshot)->bids.size() << " bids on " << socketPath
+            << " with " << threadCount << " threads" << endl;
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+
+    cout << gLatency.count() << " queries, p50 " << gLatency.percentile(0.50) / 1000.0
+            << " us, p99 " << gLatency.percentile(0.99) / 1000.0 << " us" << endl;
+
+    close(epollFd);
+    close(listenFd);
+    unlink(socketPath.c_str());
+    return 0;
+}
 
+/**
+ * Read one newline-terminated line from a blocking socket
+ */
+bool readLine(int fd, string& buffer, string& line) {
+    size_t pos;
+    while ((pos = buffer.find('\n')) == string::npos) {
+        char chunk[4096];
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, n);
+    }
+    line = buffer.substr(0, pos);
+    buffer.erase(0, pos + 1);
+    return true;
 }
 
 /**
- * Simple C function to convert a string to a double
- * after stripping out unwanted char
+ * Send one request and collect its reply lines
  *
- * @param ch The character to strip out
+ * @return false on a transport error or an ERR reply
  */
-double strToDouble(string str, char ch) {
-    str.erase(remove(str.begin(), str.end(), ch), str.end());
-    return atof(str.c_str());
+bool sendQuery(int fd, string& buffer, const string& request, vector<string>& reply) {
+    reply.clear();
+    string status;
+    if (!writeAll(fd, request + "\n") || !readLine(fd, buffer, status)) {
+        return false;
+    }
+    if (status.compare(0, 3, "OK ") != 0) {
+        return false;
+    }
+    int lines = atoi(status.c_str() + 3);
+    for (int i = 0; i < lines; ++i) {
+        string line;
+        if (!readLine(fd, buffer, line)) {
+            return false;
+        }
+        reply.push_back(line);
+    }
+    return true;
+}
+
+int connectTo(string socketPath) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    if (fd >= 0 && connect(fd, (sockaddr*) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Drive a running server with many concurrent clients and report the
+ * client-observed latency percentiles
+ *
+ * @param socketPath socket the server listens on
+ * @param clients number of concurrent connections
+ * @param requests number of requests each client sends
+ * @return process exit code
+ */
+int runLoadTest(string socketPath, int clients, int requests) {
+    // borrow real ids and titles from the server so lookups hit
+    int fd = connectTo(socketPath);
+    string buffer;
+    vector<string> sample;
+    if (fd < 0 || !sendQuery(fd, buffer, "TOPK 1000", sample) || sample.empty()) {
+        cerr << "Cannot query server on " << socketPath << endl;
+        return 1;
+    }
+    close(fd);
+    vector<string> ids, prefixes;
+    for (size_t i = 0; i < sample.size(); ++i) {
+        size_t colon = sample[i].find(": ");
+        ids.push_back(sample[i].substr(0, colon));
+        prefixes.push_back(sample[i].substr(colon + 2, 3));
+    }
+
+    LatencyHistogram latency;
+    atomic<int> failures(0);
+    vector<thread> threads;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    for (int c = 0; c < clients; ++c) {
+        threads.push_back(thread([&, c]() {
+            int conn = connectTo(socketPath);
+            if (conn < 0) {
+                failures += requests;
+                return;
+            }
+            string inbox;
+            vector<string> reply;
+            for (int r = 0; r < requests; ++r) {
+                size_t pick = (size_t) (c * 7919 + r) % ids.size();
+                string request;
+                switch (r % 5) {
+                case 0: request = "GET " + ids[pick]; break;
+                case 1: request = "PREFIX 10 " + prefixes[pick]; break;
+                case 2: request = "SEARCH 10 " + prefixes[pick] + "e"; break;
+                case 3: request = "TOPK 10"; break;
+                default: request = "FUNDS";
+                }
+                chrono::steady_clock::time_point sent = chrono::steady_clock::now();
+                if (!sendQuery(conn, inbox, request, reply)) {
+                    ++failures;
+                    continue;
+                }
+                latency.record(chrono::duration_cast<chrono::nanoseconds>(
+                        chrono::steady_clock::now() - sent).count());
+            }
+            close(conn);
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << latency.count() << " queries from " << clients << " clients in " << seconds << " sec ("
+            << latency.count() / seconds << " queries/sec), " << failures << " failed" << endl;
+    cout << "latency p50 " << latency.percentile(0.50) / 1000.0 << " us, p99 "
+            << latency.percentile(0.99) / 1000.0 << " us, p999 "
+            << latency.percentile(0.999) / 1000.0 << " us" << endl;
+    return failures == 0 ? 0 : 1;
 }
 
 /**
@@ -231,6 +2703,48 @@ double strToDouble(string str, char ch) {
  */
 int main(int argc, char* argv[]) {
 
+    // pull out option flags so the positional arguments below are unchanged
+    vector<char*> args;
+    for (int i = 0; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, 10, "--collate=") == 0) {
+            if (!parseCollation(arg.substr(10), gCollation)) {
+                cerr << "Unknown collation " << arg.substr(10) << " (use bytes, case or accents)" << endl;
+                return 1;
+            }
+        } else if (arg == "--csv-parser=classic") {
+            gCsvParser = CSV_CLASSIC;
+        } else if (arg == "--csv-parser=simd") {
+            gCsvParser = CSV_SIMD;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    argc = args.size();
+    argv = args.data();
+
+    // build every bid container and string on the counting resource
+    pmr::set_default_resource(&gBidMemory);
+
+    // the server, its load generator and batch runs never enter the
+    // interactive menu
+    if (argc >= 3 && string(argv[1]) == "--serve") {
+        return runServer(argc >= 4 ? argv[3] : "eBid_Monthly_Sales_Dec_2016.csv", argv[2]);
+    }
+    if (argc >= 3 && string(argv[1]) == "--check-csv") {
+        return checkCsv(argv[2]);
+    }
+    if (argc >= 2 && string(argv[1]) == "--batch") {
+        BatchOptions options;
+        if (!parseBatchOptions(argc, argv, options)) {
+            return 1;
+        }
+        return runBatch(options);
+    }
+    if (argc >= 3 && string(argv[1]) == "--load-test") {
+        return runLoadTest(argv[2], argc >= 4 ? atoi(argv[3]) : 1000, argc >= 5 ? atoi(argv[4]) : 100);
+    }
+
     // process command line arguments
     string csvPath;
     switch (argc) {
@@ -241,8 +2755,16 @@ int main(int argc, char* argv[]) {
         csvPath = "eBid_Monthly_Sales_Dec_2016.csv";
     }
 
+    // Every load's records and strings are carved from this arena in
+    // large blocks, and the previous load is released in one step
+    pmr::monotonic_buffer_resource bidArena(ARENA_BLOCK, &gBidMemory);
+
     // Define a vector to hold all the bids
-    vector<Bid> bids;
+    pmr::vector<Bid> bids(&bidArena);
+
+    // Search index over the titles; positions refer to bids, so it is
+    // rebuilt whenever bids is loaded or reordered
+    TitleIndex titleIndex;
 
     // Define a timer variable
     clock_t ticks;
@@ -254,6 +2776,10 @@ int main(int argc, char* argv[]) {
         cout << "  2. Display All Bids" << endl;
         cout << "  3. Selection Sort All Bids" << endl;
         cout << "  4. Quick Sort All Bids" << endl;
+        cout << "  5. Compare Title Collations" << endl;
+        cout << "  6. Search Titles" << endl;
+        cout << "  7. Memory Report" << endl;
+        cout << "  8. Compare Arena and Heap Loads" << endl;
         cout << "  9. Exit" << endl;
         cout << "Enter choice: ";
         cin >> choice;
@@ -265,7 +2791,11 @@ int main(int argc, char* argv[]) {
             ticks = clock();
 
             // Complete the method call to load the bids
-            bids = loadBids(csvPath);
+            {
+                MemoryPhaseScope phase("load");
+                releaseBids(bids, bidArena);
+                bids = loadBids(csvPath, &bidArena);
+            }
 
             cout << bids.size() << " bids read" << endl;
 
@@ -274,6 +2804,16 @@ int main(int argc, char* argv[]) {
             cout << "time: " << ticks << " clock ticks" << endl;
             cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
 
+            {
+                // wall time, since the index is built on every core
+                MemoryPhaseScope phase("index");
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                titleIndex = buildTitleIndex(bids);
+                reportTitleIndex(titleIndex);
+                cout << "index time: " << chrono::duration<double>(chrono::steady_clock::now() - start).count()
+                        << " seconds" << endl;
+            }
+
             break;
 
         case 2:
@@ -288,7 +2828,10 @@ int main(int argc, char* argv[]) {
         case 3:
         	ticks = clock();
         	// FIXME (1b): Invoke the selection sort and report timing results
-        	selectionSort(bids);
+        	{
+        	    MemoryPhaseScope phase("selection sort");
+        	    selectionSort(bids);
+        	}
         	cout << "SELECTION SORTED: ";
         	for(int i = 0; i < bids.size(); ++i) {
         		cout << bids[i].title << endl;
@@ -299,12 +2842,17 @@ int main(int argc, char* argv[]) {
             cout << ticks << endl;
             cout << ticks * (1.0/CLOCKS_PER_SEC) << " sec" << endl;
 
+            titleIndex = buildTitleIndex(bids);
+
             break;
         // FIXME (2b): Invoke the quick sort and report timing results
         case 4:
         	ticks = clock();
             // FIXME (1b): Invoke the selection sort and report timing results
-        	quickSort(bids, 0, bids.size()-1);
+        	{
+        	    MemoryPhaseScope phase("quick sort");
+        	    quickSort(bids, 0, bids.size()-1);
+        	}
             cout << "QUICKSORT: ";
             for(int i = 0; i < bids.size(); ++i) {
             	cout << bids[i].title << endl;
@@ -314,6 +2862,27 @@ int main(int argc, char* argv[]) {
             ticks = clock() - ticks;
             cout << ticks << endl;
             cout << ticks * (1.0/CLOCKS_PER_SEC) << " sec" << endl;
+
+            titleIndex = buildTitleIndex(bids);
+
+            break;
+
+        case 5:
+            cout << "Active collation: " << collationName(gCollation) << endl;
+            compareCollations(bids);
+            break;
+
+        case 6:
+            searchTitles(titleIndex, bids);
+            break;
+
+        case 7:
+            reportMemory(bids, titleIndex);
+            break;
+
+        case 8:
+            compareArena(csvPath);
+            break;
         }
     }
 
@@ -1,1300 +1,5502 @@
-#include <iostream>         
-#include <GL/glew.h> 
-#include <GLFW/glfw3.h> 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"      // Image loading Utility functions
-
-// GLM Math Header inclusions
-#include <glm/glm.hpp>
-#include <glm/gtx/transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-
-#include "camera.h" // Camera class
-
-
-
-using namespace std; // Standard namespace
-
-/*Shader program Macro*/
-#ifndef GLSL
-#define GLSL(Version, Source) "#version " #Version " core \n" #Source
-#endif
-
-// Unnamed namespace
-namespace
-{
-    const char* const WINDOW_TITLE = "Final"; // Macro for window title
-    const int STRIDE = 7;
-    // Variables for window width and height
-    const int WINDOW_WIDTH = 800;
-    const int WINDOW_HEIGHT = 600;
-
-    // Stores the GL data relative to a given mesh
-    struct GLMesh
-    {
-        GLuint toyVao, planeVao, cylinderVao, cubeVao, cube2Vao;         // Handle for the vertex array object
-        GLuint toyVbo, planeVbo, cubeVbo, cube2Vbo;         // Handle for the vertex buffer object
-        GLuint toyVertices, planeVertices, cylinderVertices, cubeVertices, cube2Vertices;    // Number of indices of the mesh
-        GLuint cylinderVbos[2];
-    };
-
-    // Main GLFW window
-    GLFWwindow* gWindow = nullptr;
-    // Triangle mesh data
-    GLMesh gMesh;
-
-    // Texture
-    GLuint gTextureId;      //toy
-    GLuint gPlanePattern;    //plane/desk
-    GLuint gSodaPattern;    //soda can
-    GLuint gCubePattern;    //supposedly ipad but will be cube
-    GLuint gCube2Pattern;   //soda tab
-
-
-
-    // Shader programs
-    GLuint gProgramId; //toy
-    GLuint gLampProgramId;  //lamp
-    GLuint gFillProgramId;  //fill
-    GLuint gPlaneProgramId; //plane
-    GLuint gSodaProgramId;  //soda
-    GLuint gCubeProgramId;  // cube
-    GLuint gCube2ProgramId; //cube2
-
-    glm::vec2 gUVScale(5.0f, 5.0f);
-    GLint gTexWrapMode = GL_REPEAT;
-
-    // camera
-    Camera gCamera(glm::vec3(0.0f, 0.0f, 8.0f));
-    float gLastX = WINDOW_WIDTH / 2.0f;
-    float gLastY = WINDOW_HEIGHT / 2.0f;
-    bool gFirstMouse = true;
-
-    // timing
-    float gDeltaTime = 0.0f; // time between current frame and last frame
-    float gLastFrame = 0.0f;
-
-    // Cube and light color
-    glm::vec3 gObjectColor(1.0f, 0.2f, 0.0f);
-
-    glm::vec3 gLightColor(1.0f, 0.9f, 1.2f);
-    glm::vec3 gLightPosition(4.0f, 5.5f, 3.0f);
-    glm::vec3 gLightScale(1.3f);
-
-    //cube position
-    glm::vec3 gCubePosition(0.75f, -0.1f, -1.0f);
-    glm::vec3 gCubeScale(2.0f);
-
-    glm::vec3 gFillColor(1.0f, 0.9f, 0.2f);
-    glm::vec3 gFillPosition(-8.0f, 11.5f, 7.0f);
-    glm::vec3 gFillScale(1.3f);
-
-    // position (pyramid)
-    glm::vec3 gToyPosition(3.0f, -0.65f, 2.0f);
-    glm::vec3 gToyScale(0.85f);
-
-    //Desk pad position (plane)
-    glm::vec3 gPlanePosition(0.0f, -0.5f, 0.0f);
-    glm::vec3 gPlaneScale(3.0f);
-
-    //cylinder position
-    glm::vec3 gSodaPosition(-2.0f, -0.32f, 2.0f);
-    glm::vec3 gSodaScale(3.0f);
-
-    //cube 2 position
-    glm::vec3 gCube2Position(-2.0f, 0.4f, 1.9f);
-    glm::vec3 gCube2Scale(0.3f);
-
-
-    // Lamp animation
-    bool gLampIsOrbiting = true;
-}
-
-/* 
- * initialize the program, set the window size,
- * redraw graphics on the window when resized,
- * and render graphics on the screen
- */
-bool UInitialize(int, char* [], GLFWwindow** window);
-void UResizeWindow(GLFWwindow* window, int width, int height);
-void UProcessInput(GLFWwindow* window);
-void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
-void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
-void UCreateSoda(GLfloat verts[], GLushort indices[], int numSides, float radius, float halfLen);
-void UCreateMesh(GLMesh& mesh);
-void UDestroyMesh(GLMesh& mesh);
-bool UCreateTexture(const char* filename, GLuint& textureId);
-void UDestroyTexture(GLuint textureId);
-void URender();
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
-void UDestroyShaderProgram(GLuint programId);
-
-
-
-/* Cube Vertex Shader Source Code*/
-const GLchar* cubeVertexShaderSource = GLSL(440,
-
-    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
-layout(location = 1) in vec3 normal; // VAP position 1 for normals
-layout(location = 2) in vec2 textureCoordinate;
-
-out vec3 vertexNormal; // For outgoing normals to fragment shader
-out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
-out vec2 vertexTextureCoordinate;
-
-//Uniform / Global variables for the  transform matrices
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-void main()
-{
-    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
-
-    vertexFragmentPos = vec3(model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
-
-    vertexNormal = mat3(transpose(inverse(model))) * normal; // get normal vectors in world space only and exclude normal translation properties
-    vertexTextureCoordinate = textureCoordinate;
-}
-);
-
-
-/* Cube Fragment Shader Source Code*/
-const GLchar* cubeFragmentShaderSource = GLSL(440,
-
-    in vec3 vertexNormal; // For incoming normals
-in vec3 vertexFragmentPos; // For incoming fragment position
-in vec2 vertexTextureCoordinate;
-
-out vec4 fragmentColor; // For outgoing cube color to the GPU
-out vec4 fillFragmentColor;
-// Uniform / Global variables for object color, light color, light position, and camera/view position
-uniform vec3 objectColor;
-uniform vec3 lightColor;
-uniform vec3 lightPos;
-uniform vec3 fillColor;
-uniform vec3 fillPos;
-uniform vec3 viewPosition;
-uniform sampler2D uTexture; // Useful when working with multiple textures
-uniform vec2 uvScale;
-
-void main()
-{
-    float ambientStrength = 0.5f; // Set ambient or global lighting strength
-    vec3 ambient = ambientStrength * lightColor; // Generate ambient light color
-
-    //Calculate Diffuse lighting*/
-    vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
-    vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
-    float impact = max(dot(norm, lightDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
-    vec3 diffuse = impact * lightColor; // Generate diffuse light color
-
-    //Calculate Specular lighting*/
-    float specularIntensity = 0.3f; // Set specular light strength
-    float highlightSize = 2.0f; // Set specular highlight size8.0f;
-    vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
-    vec3 reflectDir = reflect(-lightDirection, norm);// Calculate reflection vector
-    //Calculate specular component
-    float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
-    vec3 specular = specularIntensity * specularComponent * lightColor;
-
-
-    //Calculate key lighting*/
-    float fillAmbientStrength = 0.1f; // Set ambient or global lighting strength
-    vec3 fillAmbient = fillAmbientStrength * fillColor; // Generate ambient light color
-
-    //Calculate Diffuse lighting*/
-
-    vec3 fillDirection = normalize(fillPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
-    float fillImpact = max(dot(norm, fillDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
-    vec3 fillDiffuse = fillImpact * fillColor; // Generate diffuse light color
-
-    //Calculate Specular lighting*/
-    float fillSpecularIntensity = 0.5f; // Set specular light strength
-    float fillHighlightSize = 8.0f; // Set specular highlight size
-    vec3 fillViewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
-    vec3 fillReflectDir = reflect(-fillDirection, norm);// Calculate reflection vector
-    //Calculate specular component
-    float fillSpecularComponent = pow(max(dot(fillViewDir, fillReflectDir), 0.0), fillHighlightSize);
-    vec3 fillSpecular = fillSpecularIntensity * fillSpecularComponent * fillColor;
-
-    // Calculate phong result
-    vec3 objectColor = texture(uTexture, vertexTextureCoordinate).xyz;
-    vec3 keyResult = (ambient + diffuse + specular);
-    vec3 fillResult = (fillAmbient + fillDiffuse + fillSpecular);
-    vec3 lightingResult = keyResult + fillResult;
-    vec3 phong = (lightingResult)*objectColor;
-
-
-    fragmentColor = vec4(phong, 1.0f); // Send lighting results to GPU
-}
-);
-
-
-/* Lamp Shader Source Code*/
-const GLchar* lampVertexShaderSource = GLSL(440,
-
-    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
-
-        //Uniform / Global variables for the  transform matrices
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-void main()
-{
-    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
-}
-);
-
-
-/* Fragment Shader Source Code*/
-const GLchar* lampFragmentShaderSource = GLSL(440,
-
-    out vec4 fragmentColor; // For outgoing lamp color (smaller cube) to the GPU
-
-void main()
-{
-    fragmentColor = vec4(1.0f); // Set color to white (1.0f,1.0f,1.0f) with alpha 1.0
-}
-);
-
-
-const GLchar* fillVertexShaderSource = GLSL(440,
-
-    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
-
-        //Uniform / Global variables for the  transform matrices
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-void main()
-{
-    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
-}
-);
-
-
-/* Fragment Shader Source Code*/
-const GLchar* fillFragmentShaderSource = GLSL(440,
-
-    out vec4 fragmentColor; // For outgoing lamp color (smaller cube) to the GPU
-
-void main()
-{
-    fragmentColor = vec4(1.0f); // Set color to white (1.0f,1.0f,1.0f) with alpha 1.0
-}
-);
-
-
-
-// Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so let's flip it
-void flipImageVertically(unsigned char* image, int width, int height, int channels)
-{
-    for (int j = 0; j < height / 2; ++j)
-    {
-        int index1 = j * width * channels;
-        int index2 = (height - 1 - j) * width * channels;
-
-        for (int i = width * channels; i > 0; --i)
-        {
-            unsigned char tmp = image[index1];
-            image[index1] = image[index2];
-            image[index2] = tmp;
-            ++index1;
-            ++index2;
-        }
-    }
-}
-
-
-int main(int argc, char* argv[])
-{
-    if (!UInitialize(argc, argv, &gWindow))
-        return EXIT_FAILURE;
-
-    // Create the mesh
-    UCreateMesh(gMesh); // Calls the function to create the Vertex Buffer Object
-
-    // Create the shader programs
-    if (!UCreateShaderProgram(cubeVertexShaderSource, cubeFragmentShaderSource, gProgramId)) //toy
-        return EXIT_FAILURE;
-
-    if (!UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gLampProgramId)) //lamp
-        return EXIT_FAILURE;
-
-    if (!UCreateShaderProgram(cubeVertexShaderSource, cubeFragmentShaderSource, gPlaneProgramId))  //plane
-        return EXIT_FAILURE;
-
-    if (!UCreateShaderProgram(cubeVertexShaderSource, cubeFragmentShaderSource, gSodaProgramId))  //cylinder
-        return EXIT_FAILURE;
-
-    if (!UCreateShaderProgram(cubeVertexShaderSource, cubeFragmentShaderSource, gCubeProgramId))  //cube
-        return EXIT_FAILURE;
-
-    if (!UCreateShaderProgram(cubeVertexShaderSource, cubeFragmentShaderSource, gCube2ProgramId))  //cube2
-        return EXIT_FAILURE;
-
-    if (!UCreateShaderProgram(fillVertexShaderSource, fillFragmentShaderSource, gFillProgramId))  //fill
-        return EXIT_FAILURE;
-
-    // Load texture
-    const char* texFilename = "Tex1.jpg";  
-    if (!UCreateTexture(texFilename, gTextureId))
-    {
-        cout << "Failed to load texture " << texFilename << endl;
-        return EXIT_FAILURE;
-    }
-    texFilename = "Wood1.jpg";              //plane
-    if (!UCreateTexture(texFilename, gPlanePattern))
-    {
-        cout << "Failed to load texture " << texFilename << endl;
-        return EXIT_FAILURE;
-    }
-    texFilename = "Bricks.jpg";          //soda can
-    if (!UCreateTexture(texFilename, gSodaPattern))
-    {
-        cout << "Failed to load texture " << texFilename << endl;
-        return EXIT_FAILURE;
-    }
-    texFilename = "Blue.jpg";               //cube
-    if (!UCreateTexture(texFilename, gCubePattern))
-    {
-        cout << "Failed to load texture " << texFilename << endl;
-        return EXIT_FAILURE;
-    }
-
-    texFilename = "Blue.jpg";               //cube2
-    if (!UCreateTexture(texFilename, gCube2Pattern))
-    {
-        cout << "Failed to load texture " << texFilename << endl;
-        return EXIT_FAILURE;
-    }
-    // tell opengl for each sampler to which texture unit it belongs to
-    glUseProgram(gProgramId);
-    // We set the texture as texture unit 0
-    glUniform1i(glGetUniformLocation(gProgramId, "uTexture"), 0);
-
-    // Sets the background color of the window to black (it will be implicitely used by glClear)
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-
-    // render loop
-    // -----------
-
-    while (!glfwWindowShouldClose(gWindow))
-    {
-        // per-frame timing
-        // --------------------
-        float currentFrame = glfwGetTime();
-        gDeltaTime = currentFrame - gLastFrame;
-        gLastFrame = currentFrame;
-
-        // input
-        // -----
-        UProcessInput(gWindow);
-
-        // Render this frame
-        URender();
-
-        glfwPollEvents();
-    }
-
-    // Release mesh data
-    UDestroyMesh(gMesh);
-
-    // Release texture
-    UDestroyTexture(gTextureId);
-
-    // Release shader programs
-    UDestroyShaderProgram(gProgramId);
-    UDestroyShaderProgram(gLampProgramId);
-    UDestroyShaderProgram(gPlaneProgramId);
-    UDestroyShaderProgram(gSodaProgramId);
-    UDestroyShaderProgram(gCubeProgramId);
-    UDestroyShaderProgram(gFillProgramId);
-    UDestroyShaderProgram(gCube2ProgramId);
-    exit(EXIT_SUCCESS); // Terminates the program successfully
-}
-
-
-// Initialize GLFW, GLEW, and create a window
-bool UInitialize(int argc, char* argv[], GLFWwindow** window)
-{
-    // GLFW: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-    // GLFW: window creation
-    // ---------------------
-    * window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, NULL, NULL);
-    if (*window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return false;
-    }
-    glfwMakeContextCurrent(*window);
-    glfwSetFramebufferSizeCallback(*window, UResizeWindow);
-    glfwSetCursorPosCallback(*window, UMousePositionCallback);
-    glfwSetScrollCallback(*window, UMouseScrollCallback);
-
-
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(*window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    // GLEW: initialize
-    // ----------------
-    // Note: if using GLEW version 1.13 or earlier
-    glewExperimental = GL_TRUE;
-    GLenum GlewInitResult = glewInit();
-
-    if (GLEW_OK != GlewInitResult)
-    {
-        std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
-        return false;
-    }
-
-    // Displays GPU OpenGL version
-    cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
-
-    return true;
-}
-
-
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-void UProcessInput(GLFWwindow* window)
-{
-    static const float cameraSpeed = 2.5f;
-
-
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
-
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(FORWARD, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(BACKWARD, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(LEFT, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(RIGHT, gDeltaTime);
-
-
-
-    // Add stubs for Q/E Upward/Downward movement
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(FORWARD, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(BACKWARD, gDeltaTime);
-
-    // Pause and resume lamp orbiting
-    static bool isLKeyDown = false;
-    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !gLampIsOrbiting)
-        gLampIsOrbiting = true;
-    else if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS && gLampIsOrbiting)
-        gLampIsOrbiting = false;
-
-}
-
-
-// glfw: whenever the window size changed (by OS or user resize) this callback function executes
-void UResizeWindow(GLFWwindow* window, int width, int height)
-{
-    glViewport(0, 0, width, height);
-}
-
-
-// glfw: whenever the mouse moves, this callback is called
-// -------------------------------------------------------
-void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
-{
-    if (gFirstMouse)
-    {
-        gLastX = xpos;
-        gLastY = ypos;
-        gFirstMouse = false;
-    }
-
-    float xoffset = xpos - gLastX;
-    float yoffset = gLastY - ypos; // reversed since y-coordinates go from bottom to top
-
-    gLastX = xpos;
-    gLastY = ypos;
-
-    gCamera.ProcessMouseMovement(xoffset, yoffset);
-}
-
-
-// glfw: whenever the mouse scroll wheel scrolls, this callback is called
-// ----------------------------------------------------------------------
-void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
-{
-    gCamera.ProcessMouseScroll(yoffset);
-}
-
-// glfw: handle mouse button events
-// --------------------------------
-
-
-
-//Create cylinder
-void UCreateSoda(GLfloat verts[], GLushort indices[], int numSides, float radius, float halfLen) {
-    const float TWO_PI = 2.0f * 3.1415926f;
-    const float radiansPerSide = TWO_PI / numSides;
-
-    int currentVertex = 0;
-
-    verts[0] = 0.0f;        //0 x
-    verts[1] = halfLen;     //0 y
-    verts[2] = 0.0f;        //0 z
-    verts[3] = 0.0f;        //0 r
-    verts[4] = 0.0f;        //0 g    
-    verts[5] = 0.0f;        //0 b
-    verts[6] = 1.0f;        //0 a
-    currentVertex++;
-    verts[7] = 0.0f;        //1 x
-    verts[8] = -halfLen;    //1 y
-    verts[9] = 0.0f;        //1 z
-    verts[10] = 0.0f;       //1 r
-    verts[11] = 0.0f;       //1 g
-    verts[12] = 0.0f;       //1 b
-    verts[13] = 1.0f;       //1 a
-    currentVertex++;
-
-    int currentTriangle = 0;
-    for (int edge = 0; edge < numSides; edge++) {
-        float theta = ((float)edge) * radiansPerSide;
-
-        verts[currentVertex * STRIDE + 0] = radius * cos(theta);    //x
-        verts[currentVertex * STRIDE + 1] = halfLen;                //y
-        verts[currentVertex * STRIDE + 2] = radius * sin(theta);    //z
-        verts[currentVertex * STRIDE + 3] = 1.0f;                   //r
-        verts[currentVertex * STRIDE + 4] = 0.0f;                   //g
-        verts[currentVertex * STRIDE + 5] = 0.0f;                   //b
-        verts[currentVertex * STRIDE + 6] = 1.0f;                   //a
-        currentVertex++;
-
-        verts[currentVertex * STRIDE + 0] = radius * cos(theta);    //x
-        verts[currentVertex * STRIDE + 1] = -halfLen;               //y
-        verts[currentVertex * STRIDE + 2] = radius * sin(theta);    //z
-        verts[currentVertex * STRIDE + 3] = 1.0f;                   //r
-        verts[currentVertex * STRIDE + 4] = 0.0f;                   //g
-        verts[currentVertex * STRIDE + 5] = 0.0f;                   //b
-        verts[currentVertex * STRIDE + 6] = 1.0f;                   //a
-        currentVertex++;
-
-
-        if (edge > 0) {
-            //top triangle
-            indices[(3 * currentTriangle) + 0] = 0;
-            indices[(3 * currentTriangle) + 1] = currentVertex - 4;
-            indices[(3 * currentTriangle) + 2] = currentVertex - 2;
-            currentTriangle++;
-
-            //bottom triangle
-            indices[(3 * currentTriangle) + 0] = 1;
-            indices[(3 * currentTriangle) + 1] = currentVertex - 3;
-            indices[(3 * currentTriangle) + 2] = currentVertex - 1;
-            currentTriangle++;
-
-            //triangle for 1/2 rectangular side
-            indices[(3 * currentTriangle) + 0] = currentVertex - 4;
-            indices[(3 * currentTriangle) + 1] = currentVertex - 3;
-            indices[(3 * currentTriangle) + 2] = currentVertex - 1;
-            currentTriangle++;
-
-            //traingle for second 1/2 rectangular side
-            indices[(3 * currentTriangle) + 0] = currentVertex - 1;
-            indices[(3 * currentTriangle) + 1] = currentVertex - 2;
-            indices[(3 * currentTriangle) + 2] = currentVertex - 4;
-            currentTriangle++;
-        }
-    }
-
-    indices[(3 * currentTriangle) + 0] = 0;
-    indices[(3 * currentTriangle) + 1] = currentVertex - 2;
-    indices[(3 * currentTriangle) + 2] = 2;
-    currentTriangle++;
-    indices[(3 * currentTriangle) + 0] = 1;
-    indices[(3 * currentTriangle) + 1] = currentVertex - 1;
-    indices[(3 * currentTriangle) + 2] = 3;
-    currentTriangle++;
-    indices[(3 * currentTriangle) + 0] = currentVertex - 2;
-    indices[(3 * currentTriangle) + 1] = currentVertex - 1;
-    indices[(3 * currentTriangle) + 2] = 3;
-    currentTriangle++;
-    indices[(3 * currentTriangle) + 0] = 3;
-    indices[(3 * currentTriangle) + 1] = 2;
-    indices[(3 * currentTriangle) + 2] = currentVertex - 2;
-    currentTriangle++;
-}
-
-
-
-
-// Functioned called to render a frame
-void URender()
-{
-    // Lamp orbits around the origin
-    const float angularVelocity = glm::radians(45.0f);
-    if (!gLampIsOrbiting)
-    {
-        glm::vec4 newPosition = glm::rotate(angularVelocity * gDeltaTime, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(gLightPosition, 1.0f);
-        gLightPosition.x = newPosition.x;
-        gLightPosition.y = newPosition.y;
-        gLightPosition.z = newPosition.z;
-    }
-
-    // Enable z-depth
-    glEnable(GL_DEPTH_TEST);
-
-    // Clear the frame and z buffers
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Activate the cube VAO (used by cube and lamp)
-    glBindVertexArray(gMesh.toyVao);
-
-    // CUBE: draw toy
-    //----------------
-    // Set the shader to be used
-    glUseProgram(gProgramId);
-
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = glm::translate(gToyPosition) * glm::scale(gToyScale);
-
-    // camera/view transformation
-    glm::mat4 view = gCamera.GetViewMatrix();
-
-    // Creates a perspective projection
-    glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-
-    // Retrieves and passes transform matrices to the Shader program
-    GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    // Reference matrix uniforms from the Cube Shader program for the cube color, light color, light position, and camera position
-    GLint objectColorLoc = glGetUniformLocation(gProgramId, "objectColor");
-    GLint lightColorLoc = glGetUniformLocation(gProgramId, "lightColor");
-    GLint lightPositionLoc = glGetUniformLocation(gProgramId, "lightPos");
-    GLint fillColorLoc = glGetUniformLocation(gProgramId, "fillColor");
-    GLint fillPositionLoc = glGetUniformLocation(gProgramId, "fillPos");
-    GLint viewPositionLoc = glGetUniformLocation(gProgramId, "viewPosition");
-
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    glUniform3f(objectColorLoc, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    glUniform3f(fillColorLoc, gFillColor.r, gFillColor.g, gFillColor.b);
-    glUniform3f(fillPositionLoc, gFillPosition.x, gFillPosition.y, gFillPosition.z);
-
-    const glm::vec3 cameraPosition = gCamera.Position;
-    glUniform3f(viewPositionLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-
-    GLint UVScaleLoc = glGetUniformLocation(gProgramId, "uvScale");
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
-
-    // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gTextureId);
-
-    // Draws the triangles
-    glDrawArrays(GL_TRIANGLES, 0, gMesh.toyVertices);
-
-
-
-    //Draw plane
-
-    glUseProgram(gProgramId);
-
-    glBindTexture(GL_TEXTURE_2D, gPlanePattern);
-    glActiveTexture(GL_TEXTURE0);
-
-    model = glm::translate(gPlanePosition) * glm::scale(gPlaneScale);
-
-    modelLoc = glGetUniformLocation(gPlaneProgramId, "model");
-    viewLoc = glGetUniformLocation(gPlaneProgramId, "view");
-    projLoc = glGetUniformLocation(gPlaneProgramId, "projection");
-
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glBindVertexArray(gMesh.planeVao);
-
-    glDrawArrays(GL_TRIANGLES, 0, gMesh.planeVertices);
-
-
-
-
-    //Draw cylinder
-    glUseProgram(gProgramId);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gSodaPattern);
-
-
-    model = glm::translate(gSodaPosition) * glm::scale(gSodaScale);
-
-    modelLoc = glGetUniformLocation(gSodaProgramId, "model");
-    viewLoc = glGetUniformLocation(gSodaProgramId, "view");
-    projLoc = glGetUniformLocation(gSodaProgramId, "projection");
-
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    glBindVertexArray(gMesh.cylinderVao);
-
-    glDrawElements(GL_TRIANGLES, gMesh.cylinderVertices, GL_UNSIGNED_SHORT, NULL);
-
-
-
-
-
-    //Draw cube
-
-    glUseProgram(gProgramId);
-    glBindTexture(GL_TEXTURE_2D, gCubePattern);
-    glActiveTexture(GL_TEXTURE0);
-
-    model = glm::translate(gCubePosition) * glm::scale(gCubeScale);
-
-    modelLoc = glGetUniformLocation(gCubeProgramId, "model");
-    viewLoc = glGetUniformLocation(gCubeProgramId, "view");
-    projLoc = glGetUniformLocation(gCubeProgramId, "projection");
-
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glBindVertexArray(gMesh.cubeVao);
-
-    glDrawArrays(GL_TRIANGLES, 0, gMesh.cubeVertices);
-
-
-    //Draw cube2
-
-    glUseProgram(gProgramId);
-    glBindTexture(GL_TEXTURE_2D, gCube2Pattern);
-    glActiveTexture(GL_TEXTURE0);
-
-    model = glm::translate(gCube2Position) * glm::scale(gCube2Scale);
-
-    modelLoc = glGetUniformLocation(gCube2ProgramId, "model");
-    viewLoc = glGetUniformLocation(gCube2ProgramId, "view");
-    projLoc = glGetUniformLocation(gCube2ProgramId, "projection");
-
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glBindVertexArray(gMesh.cube2Vao);
-
-    glDrawArrays(GL_TRIANGLES, 0, gMesh.cube2Vertices);
-
-
-
-    // LAMP: draw lamp
-    glUseProgram(gLampProgramId);
-
-    //Transform the smaller cube used as a visual que for the light source
-    model = glm::translate(gLightPosition) * glm::scale(gLightScale);
-
-    // Reference matrix uniforms from the Lamp Shader program
-    modelLoc = glGetUniformLocation(gLampProgramId, "model");
-    viewLoc = glGetUniformLocation(gLampProgramId, "view");
-    projLoc = glGetUniformLocation(gLampProgramId, "projection");
-
-    // Pass matrix data to the Lamp Shader program's matrix uniforms
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    glDrawArrays(GL_TRIANGLES, 0, gMesh.cylinderVertices);
-
-
-    //Draw fill
-    glUseProgram(gFillProgramId);
-
-    //Transform the smaller cube used as a visual que for the light source
-    model = glm::translate(gFillPosition) * glm::scale(gFillScale);
-
-    // Reference matrix uniforms from the Lamp Shader program
-    modelLoc = glGetUniformLocation(gFillProgramId, "model");
-    viewLoc = glGetUniformLocation(gFillProgramId, "view");
-    projLoc = glGetUniformLocation(gFillProgramId, "projection");
-
-    // Pass matrix data to the Lamp Shader program's matrix uniforms
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    glDrawArrays(GL_TRIANGLES, 0, gMesh.cylinderVertices);
-
-    // Deactivate the Vertex Array Object and shader program
-    glBindVertexArray(0);
-    glUseProgram(0);
-
-    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-    glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
-
-
-}
-
-
-// Implements the UCreateMesh function
-void UCreateMesh(GLMesh& mesh)
-{
-    const int NUM_SIDES = 100;
-    const int NUM_VERTICES = STRIDE * (2 + (2 * NUM_SIDES));
-    const int NUM_INDICES = 12 * NUM_SIDES;
-    GLfloat verts[NUM_VERTICES];
-    GLushort indices[NUM_INDICES];
-
-
-
-    // Position and Color data
-    GLfloat toyVerts[] = {
-        //Positions                Normals                Textures
-
-       -0.5f, -0.5f, -0.5f,     0.0f,  0.0f, -1.0f,      0.0f, 0.0f,
-        0.5f, -0.5f, -0.5f,     0.0f,  0.0f, -1.0f,      1.0f, 0.0f,
-        0.0f,  0.5f,  0.0f,     0.0f,  0.0f, -1.0f,      0.5f, 1.0f,
-
-       -0.5f, -0.5f,  0.5f,     0.0f,  0.0f,  1.0f,      0.0f, 0.0f,
-        0.5f, -0.5f,  0.5f,     0.0f,  0.0f,  1.0f,      1.0f, 0.0f,
-        0.0f,  0.5f,  0.0f,     0.0f,  0.0f,  1.0f,      0.5f, 1.0f,
-
-       -0.5f, -0.5f, -0.5f,    -1.0f,  0.0f,  0.0f,      0.0f, 1.0f,
-       -0.5f, -0.5f,  0.5f,    -1.0f,  0.0f,  0.0f,      0.0f, 0.0f,
-        0.0f,  0.5f,  0.0f,    -1.0f,  0.0f,  0.0f,      0.5f, 1.0f,
-
-        0.5f, -0.5f, -0.5f,     1.0f,  0.0f,  0.0f,      0.0f, 1.0f,
-        0.5f, -0.5f,  0.5f,     1.0f,  0.0f,  0.0f,      0.0f, 0.0f,
-        0.0f,  0.5f,  0.0f,     1.0f,  0.0f,  0.0f,      0.5f, 1.0f,
-
-        0.5f, -0.5f, -0.5f,     0.0f, -1.0f,  0.0f,      1.0f, 1.0f,
-        0.5f, -0.5f,  0.5f,     0.0f, -1.0f,  0.0f,      1.0f, 0.0f,
-        0.0f,  0.5f,  0.0f,     0.0f, -1.0f,  0.0f,      0.5f, 1.0f,
-
-       -0.5f, -0.5f,  0.5f,     0.0f,  1.0f,  0.0f,      0.0f, 0.0f,
-       -0.5f, -0.5f, -0.5f,     0.0f,  1.0f,  0.0f,      0.0f, 1.0f,
-        0.0f,  0.5f,  0.0f,     0.0f,  1.0f,  0.0f,      0.5f, 1.0f
-
-
-    };
-    GLfloat planeVerts[] = {
-        //Positions                      Normals                Textures
-          2.0f, -0.2f,  1.0f,        0.0f,  0.0f, 1.0f,        1.0f, 0.0f,
-         -2.0f, -0.2f, -1.0f,        0.0f,  0.0f, 1.0f,        0.0f, 0.0f,
-          2.0f, -0.2f, -1.0f,        0.0f,  0.0f, 1.0f,        0.0f, 1.0f,
-
-          2.0f, -0.2f,  1.0f,        0.0f,  0.0f, 1.0f,        1.0f, 0.0f,
-         -2.0f, -0.2f,  1.0f,        0.0f,  0.0f, 1.0f,        1.0f, 1.0f,
-         -2.0f, -0.2f, -1.0f,        0.0f,  0.0f, 1.0f,        0.0f, 0.0f,
-    };
-
-    GLfloat cubeVerts[] = {
-        //Positions                      Normals                Textures
-
-         -0.5f, -0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        0.0f, 0.0f,
-          0.5f, -0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        1.0f, 0.0f,
-          0.5f,  0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        1.0f, 1.0f,
-          0.5f,  0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        1.0f, 1.0f,
-         -0.5f,  0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        0.0f, 1.0f,
-         -0.5f, -0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        0.0f, 0.0f,
-
-
-         -0.5f, -0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        0.0f, 0.0f,
-          0.5f, -0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        1.0f, 0.0f,
-          0.5f,  0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        1.0f, 1.0f,
-          0.5f,  0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        1.0f, 1.0f,
-         -0.5f,  0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        0.0f, 1.0f,
-         -0.5f, -0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        0.0f, 0.0f,
-
-
-         -0.5f,  0.5f,  0.5f,      -1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
-         -0.5f,  0.5f, -0.5f,      -1.0f,  0.0f,  0.0f,        1.0f, 1.0f,
-         -0.5f, -0.5f, -0.5f,      -1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
-         -0.5f, -0.5f, -0.5f,      -1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
-         -0.5f, -0.5f,  0.5f,      -1.0f,  0.0f,  0.0f,        0.0f, 0.0f,
-         -0.5f,  0.5f,  0.5f,      -1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
-
-
-          0.5f,  0.5f,  0.5f,       1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
-          0.5f,  0.5f, -0.5f,       1.0f,  0.0f,  0.0f,        1.0f, 1.0f,
-          0.5f, -0.5f, -0.5f,       1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
-          0.5f, -0.5f, -0.5f,       1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
-          0.5f, -0.5f,  0.5f,       1.0f,  0.0f,  0.0f,        0.0f, 0.0f,
-          0.5f,  0.5f,  0.5f,       1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
-
-
-         -0.5f, -0.5f, -0.5f,       0.0f, -1.0f,  0.0f,        0.0f, 1.0f,
-          0.5f, -0.5f, -0.5f,       0.0f, -1.0f,  0.0f,        1.0f, 1.0f,
-          0.5f, -0.5f,  0.5f,       0.0f, -1.0f,  0.0f,        1.0f, 0.0f,
-          0.5f, -0.5f,  0.5f,       0.0f, -1.0f,  0.0f,        1.0f, 0.0f,
-         -0.5f, -0.5f,  0.5f,       0.0f, -1.0f,  0.0f,        0.0f, 0.0f,
-         -0.5f, -0.5f, -0.5f,       0.0f, -1.0f,  0.0f,        0.0f, 1.0f,
-
-
-         -0.5f,  0.5f, -0.5f,       0.0f,  1.0f,  0.0f,        0.0f, 1.0f,
-          0.5f,  0.5f, -0.5f,       0.0f,  1.0f,  0.0f,        1.0f, 1.0f,
-          0.5f,  0.5f,  0.5f,       0.0f,  1.0f,  0.0f,        1.0f, 0.0f,
-          0.5f,  0.5f,  0.5f,       0.0f,  1.0f,  0.0f,        1.0f, 0.0f,
-         -0.5f,  0.5f,  0.5f,       0.0f,  1.0f,  0.0f,        0.0f, 0.0f,
-         -0.5f,  0.5f, -0.5f,       0.0f,  1.0f,  0.0f,        0.0f, 1.0f
-    };
-
-    GLfloat cube2Verts[] = {
-        //Positions                      Normals                Textures
-
-         -0.5f, -0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        0.0f, 0.0f,
-          0.5f, -0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        1.0f, 0.0f,
-          0.5f,  0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        1.0f, 1.0f,
-          0.5f,  0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        1.0f, 1.0f,
-         -0.5f,  0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        0.0f, 1.0f,
-         -0.5f, -0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        0.0f, 0.0f,
-
-
-         -0.5f, -0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        0.0f, 0.0f,
-          0.5f, -0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        1.0f, 0.0f,
-          0.5f,  0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        1.0f, 1.0f,
-          0.5f,  0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        1.0f, 1.0f,
-         -0.5f,  0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        0.0f, 1.0f,
-         -0.5f, -0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        0.0f, 0.0f,
-
-
-         -0.5f,  0.5f,  0.5f,      -1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
-         -0.5f,  0.5f, -0.5f,      -1.0f,  0.0f,  0.0f,        1.0f, 1.0f,
-         -0.5f, -0.5f, -0.5f,      -1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
-         -0.5f, -0.5f, -0.5f,      -1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
-         -0.5f, -0.5f,  0.5f,      -1.0f,  0.0f,  0.0f,        0.0f, 0.0f,
-         -0.5f,  0.5f,  0.5f,      -1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
-
-
-          0.5f,  0.5f,  0.5f,       1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
-          0.5f,  0.5f, -0.5f,       1.0f,  0.0f,  0.0f,        1.0f, 1.0f,
-          0.5f, -0.5f, -0.5f,       1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
-          0.5f, -0.5f, -0.5f,       1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
-          0.5f, -0.5f,  0.5f,       1.0f,  0.0f,  0.0f,        0.0f, 0.0f,
-          0.5f,  0.5f,  0.5f,       1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
-
-
-         -0.5f, -0.5f, -0.5f,       0.0f, -1.0f,  0.0f,        0.0f, 1.0f,
-          0.5f, -0.5f, -0.5f,       0.0f, -1.0f,  0.0f,        1.0f, 1.0f,
-          0.5f, -0.5f,  0.5f,       0.0f, -1.0f,  0.0f,        1.0f, 0.0f,
-          0.5f, -0.5f,  0.5f,       0.0f, -1.0f,  0.0f,        1.0f, 0.0f,
-         -0.5f, -0.5f,  0.5f,       0.0f, -1.0f,  0.0f,        0.0f, 0.0f,
-         -0.5f, -0.5f, -0.5f,       0.0f, -1.0f,  0.0f,        0.0f, 1.0f,
-
-
-         -0.5f,  0.5f, -0.5f,       0.0f,  1.0f,  0.0f,        0.0f, 1.0f,
-          0.5f,  0.5f, -0.5f,       0.0f,  1.0f,  0.0f,        1.0f, 1.0f,
-          0.5f,  0.5f,  0.5f,       0.0f,  1.0f,  0.0f,        1.0f, 0.0f,
-          0.5f,  0.5f,  0.5f,       0.0f,  1.0f,  0.0f,        1.0f, 0.0f,
-         -0.5f,  0.5f,  0.5f,       0.0f,  1.0f,  0.0f,        0.0f, 0.0f,
-         -0.5f,  0.5f, -0.5f,       0.0f,  1.0f,  0.0f,        0.0f, 1.0f
-    };
-
-
-    //fill verts/indices arrays with data 
-    UCreateSoda(verts, indices, NUM_SIDES, 0.15f, 0.25f);
-
-
-
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerNormal = 3;
-    const GLuint floatsPerUV = 2;
-
-    mesh.toyVertices = sizeof(toyVerts) / (sizeof(toyVerts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
-
-    glGenVertexArrays(1, &mesh.toyVao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.toyVao);
-
-    // Create 1 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(1, &mesh.toyVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.toyVbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(toyVerts), toyVerts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);// The number of floats before each
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
-
-
-
-
-
-
-    //Draw plane
-    mesh.planeVertices = sizeof(planeVerts) / (sizeof(planeVerts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
-
-    glGenVertexArrays(1, &mesh.planeVao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.planeVao);
-
-    // Create 1 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(1, &mesh.planeVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.planeVbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVerts), planeVerts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
-
-
-
-
-
-
-
-    //Draw Cylinder
-    const GLuint floatsPerVertex2 = 3;
-    const GLuint floatsPerColor2 = 4;
-    const GLuint floatsPerUV2 = 2;
-
-    glGenVertexArrays(1, &mesh.cylinderVao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.cylinderVao);
-
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(2, mesh.cylinderVbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.cylinderVbos[0]); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    mesh.cylinderVertices = sizeof(indices) / sizeof(indices[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.cylinderVbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint stride2 = sizeof(float) * (floatsPerVertex2 + floatsPerColor2);// The number of floats before each
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex2, GL_FLOAT, GL_FALSE, stride2, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerColor2, GL_FLOAT, GL_FALSE, stride2, (char*)(sizeof(float) * floatsPerVertex2));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV2, GL_FLOAT, GL_FALSE, stride2, (char*)(sizeof(float) * (floatsPerVertex2 + floatsPerColor2)));
-    glEnableVertexAttribArray(2);
-
-
-
-
-
-
-
-    //Draw cube
-
-
-    const GLuint cubeFloatsPerVertex = 3;
-    const GLuint cubeFloatsPerNormal = 3;
-    const GLuint cubeFloatsPerUV = 2;
-
-    mesh.cubeVertices = sizeof(cubeVerts) / (sizeof(cubeVerts[0]) * (cubeFloatsPerVertex + cubeFloatsPerNormal + cubeFloatsPerUV));
-
-    glGenVertexArrays(1, &mesh.cubeVao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.cubeVao);
-
-    // Create 1 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(1, &mesh.cubeVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.cubeVbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVerts), cubeVerts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint cubeStride = sizeof(float) * (cubeFloatsPerVertex + cubeFloatsPerNormal + cubeFloatsPerUV);// The number of floats before each
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, cubeFloatsPerVertex, GL_FLOAT, GL_FALSE, cubeStride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, cubeFloatsPerNormal, GL_FLOAT, GL_FALSE, cubeStride, (void*)(sizeof(float) * cubeFloatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, cubeFloatsPerUV, GL_FLOAT, GL_FALSE, cubeStride, (void*)(sizeof(float) * (cubeFloatsPerVertex + cubeFloatsPerNormal)));
-    glEnableVertexAttribArray(2);
-
-
-
-
-
-    //Draw cube2
-
-    const GLuint cube2FloatsPerVertex = 3;
-    const GLuint cube2FloatsPerNormal = 3;
-    const GLuint cube2FloatsPerUV = 2;
-
-    mesh.cube2Vertices = sizeof(cube2Verts) / (sizeof(cube2Verts[0]) * (cube2FloatsPerVertex + cube2FloatsPerNormal + cube2FloatsPerUV));
-
-    glGenVertexArrays(1, &mesh.cube2Vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.cube2Vao);
-
-    // Create 1 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(1, &mesh.cube2Vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.cube2Vbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cube2Verts), cube2Verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint cube2Stride = sizeof(float) * (cube2FloatsPerVertex + cube2FloatsPerNormal + cube2FloatsPerUV);// The number of floats before each
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, cube2FloatsPerVertex, GL_FLOAT, GL_FALSE, cube2Stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, cube2FloatsPerNormal, GL_FLOAT, GL_FALSE, cube2Stride, (void*)(sizeof(float) * cube2FloatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, cube2FloatsPerUV, GL_FLOAT, GL_FALSE, cube2Stride, (void*)(sizeof(float) * (cube2FloatsPerVertex + cube2FloatsPerNormal)));
-    glEnableVertexAttribArray(2);
-
-}
-
-
-void UDestroyMesh(GLMesh& mesh)
-{
-    glDeleteVertexArrays(1, &mesh.toyVao);
-    glDeleteBuffers(1, &mesh.toyVbo);
-}
-
-
-/*Generate and load the texture*/
-bool UCreateTexture(const char* filename, GLuint& textureId)
-{
-    int width, height, channels;
-    unsigned char* image = stbi_load(filename, &width, &height, &channels, 0);
-    if (image)
-    {
-        flipImageVertically(image, width, height, channels);
-
-        glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
-
-        // set the texture wrapping parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        // set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        if (channels == 3)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-        else if (channels == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-        else
-        {
-            cout << "Not implemented to handle image with " << channels << " channels" << endl;
-            return false;
-        }
-
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        stbi_image_free(image);
-        glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
-
-        return true;
-    }
-
-    // Error loading the image
-    return false;
-}
-
-
-void UDestroyTexture(GLuint textureId)
-{
-    glGenTextures(1, &textureId);
-}
-
-
-// Implements the UCreateShaders function
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
-{
-    // Compilation and linkage error reporting
-    int success = 0;
-    char infoLog[512];
-
-    // Create a Shader program object.
-    programId = glCreateProgram();
-
-    // Create the vertex and fragment shader objects
-    GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
-
-    // Retrive the shader source
-    glShaderSource(vertexShaderId, 1, &vtxShaderSource, NULL);
-    glShaderSource(fragmentShaderId, 1, &fragShaderSource, NULL);
-
-    // Compile the vertex shader, and print compilation errors (if any)
-    glCompileShader(vertexShaderId); // compile the vertex shader
-    // check for shader compile errors
-    glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertexShaderId, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    glCompileShader(fragmentShaderId); // compile the fragment shader
-    // check for shader compile errors
-    glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    // Attached compiled shaders to the shader program
-    glAttachShader(programId, vertexShaderId);
-    glAttachShader(programId, fragmentShaderId);
-
-    glLinkProgram(programId);   // links the shader program
-    // check for linking errors
-    glGetProgramiv(programId, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    glUseProgram(programId);    // Uses the shader program
-
-    return true;
-}
-
-
-void UDestroyShaderProgram(GLuint programId)
-{
-    glDeleteProgram(programId);
+#include <iostream>         
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#ifdef _WIN32
+#define NOMINMAX
+#include <io.h>             // dup
+#include <windows.h>        // file mapping
+#else
+#define EGL_NO_X11          // no Xlib types or macros from eglplatform.h
+#include <EGL/egl.h>        // headless contexts
+#include <EGL/eglext.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <GL/glew.h> 
+#include <GLFW/glfw3.h> 
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"      // Image loading Utility functions
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "camera.h" // Camera class
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+
+
+using namespace std; // Standard namespace
+
+/*Shader program Macro*/
+#ifndef GLSL
+#define GLSL(Version, Source) "#version " #Version " core \n" #Source
+#endif
+// the same, for a shader that needs an extension
+#ifndef GLSL_EXT
+#define GLSL_EXT(Version, Extension, Source) "#version " #Version " core \n#extension " #Extension " : require\n" #Source
+#endif
+
+// Unnamed namespace
+namespace
+{
+    const char* const WINDOW_TITLE = "Final"; // Macro for window title
+    // Variables for window width and height
+    const int WINDOW_WIDTH = 800;
+    const int WINDOW_HEIGHT = 600;
+
+    // Parametric shapes, each generated at LOD_COUNT levels of detail
+    enum ShapeKind { SHAPE_CYLINDER, SHAPE_CONE, SHAPE_SPHERE, SHAPE_COUNT };
+    const int LOD_COUNT = 4;
+    // sides around the axis at each level, finest first
+    const int LOD_SIDES[LOD_COUNT] = { 64, 32, 16, 8 };
+    // a level is used while the shape is at least this many pixels tall
+    const float LOD_MIN_PIXELS[LOD_COUNT] = { 160.0f, 60.0f, 20.0f, 0.0f };
+
+    // One mesh, or one level of detail of a shape, inside the shared
+    // vertex and index buffers; its indices count from baseVertex
+    struct MeshRange
+    {
+        GLuint firstIndex;
+        GLsizei indexCount;
+        GLsizei vertexCount;
+        GLint baseVertex;
+        glm::vec4 decode;       // position = xyz + w * the stored (normalized) one; see UDecodeMatrix()
+    };
+
+    // Stores the GL data relative to a given mesh
+    struct GLMesh
+    {
+        // every static mesh in one vertex and one index buffer, all in the
+        // 8-float (position, normal, uv) format behind a single VAO
+        GLuint vao, vbo, ibo;
+        GLenum indexType;       // GL_UNSIGNED_SHORT while no mesh has more than 65536 vertices
+        MeshRange toy, plane, cube;     // the unit cube is shared by every cube
+
+        // every shape at every level of detail
+        MeshRange shapeLods[SHAPE_COUNT][LOD_COUNT];
+        float shapeRadius[SHAPE_COUNT];     // bounding sphere about the origin
+        glm::vec4 toyBounds, planeBounds, cubeBounds;   // bounding sphere: centre xyz, radius w
+    };
+
+    // Compact vertex (16 bytes against 32 as floats): the position as
+    // snorm16 within the mesh's bounding cube, the normal as snorm
+    // 2_10_10_10, the uv as unorm16
+    struct PackedVertex
+    {
+        GLshort position[4];    // xyz, w unused
+        GLuint normal;          // x in the low 10 bits, then y, then z
+        GLushort uv[2];
+    };
+
+    // A mesh after welding and reordering, before upload
+    struct IndexedMesh
+    {
+        vector<GLfloat> vertices;
+        vector<GLuint> indices;
+        GLenum indexType;       // GL_UNSIGNED_SHORT when every index fits
+        vector<PackedVertex> packed;    // vertices in the compact format, when uploaded so
+        bool unitUvs = true;    // every uv inside [0,1], as the compact format needs
+    };
+
+    // --no-vertex-compression keeps static geometry in 32-bit floats
+    bool gCompactVertices = true;
+    // largest difference a compact vertex decodes to from the float one:
+    // position in mesh units, normal in degrees, uv
+    float gPositionError = 0.0f, gNormalError = 0.0f, gUvError = 0.0f;
+
+    // Post-transform cache size the index order is tuned for and scored on
+    const int VERTEX_CACHE_SIZE = 32;
+
+    // Main GLFW window
+    GLFWwindow* gWindow = nullptr;
+
+    // --headless renders into an offscreen framebuffer, with no window or
+    // display; --capture=PREFIX writes every --capture-every=N'th frame
+    // to PREFIX<frame>.ppm
+    bool gHeadless = false;
+    // --frames=N stops after N frames; headless runs and benchmarks
+    // stop by themselves, 0 runs until the window closes
+    long gRunFrames = 0;
+    string gCapturePrefix;
+    long gCaptureEvery = 1;
+    // headless and benchmark frames advance the scene by a fixed step, so
+    // runs repeat
+    const float HEADLESS_FRAME_TIME = 1.0f / 60.0f;
+
+    // frames the GPU may render ahead of their readback
+    const int READBACK_SLOTS = 3;
+
+    // Offscreen framebuffer of a headless run and the PBOs its frames are
+    // read back through
+    struct HeadlessTarget
+    {
+#ifndef _WIN32
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLContext context = EGL_NO_CONTEXT;
+#endif
+        GLuint fbo, colorRenderbuffer, depthRenderbuffer;
+        GLuint pbos[READBACK_SLOTS];
+        GLsync slotFences[READBACK_SLOTS];  // readback into the slot done; 0 when free
+        long slotFrames[READBACK_SLOTS];    // frame number being read into each slot
+        int nextSlot;
+        long framesRendered, framesRead, imagesWritten;
+        vector<unsigned char> row;          // staging for one image row
+    };
+    HeadlessTarget gHeadlessTarget = {};
+
+    // A camera pose on a recorded or scripted path, at time seconds in
+    struct CameraKey
+    {
+        float time;
+        glm::vec3 position;
+        float yaw, pitch, zoom;
+    };
+
+    // frames a benchmark's GPU timer queries may be outstanding for
+    const int BENCHMARK_QUERY_SLOTS = 4;
+
+    // --benchmark[=PATH] replays a camera path, from a file written by
+    // --record-path=PATH or the built-in orbit, with the lamp orbiting and
+    // no input, and reports frame times as JSON to stdout or
+    // --benchmark-out=FILE. Reporting to stdout, every other line the run
+    // prints goes to stderr, so stdout carries nothing but the JSON.
+    struct BenchmarkRun
+    {
+        bool enabled;
+        string pathFile;            // empty for the built-in orbit
+        string outFile;
+        int reportFd;               // the real stdout, when the report goes there
+        vector<CameraKey> keys;
+        long warmupFrames;          // left out of the statistics
+        vector<double> cpuFrameMs, cpuRenderMs, gpuFrameMs;
+        GLuint queries[BENCHMARK_QUERY_SLOTS][2];  // GPU timestamps at the start and end of a frame
+        long queryFrames[BENCHMARK_QUERY_SLOTS];   // frame timed by each pair, 0 when free
+        int nextQuery;
+        long gpuFrames;
+    };
+    BenchmarkRun gBenchmark = {};
+    // camera poses are appended here every frame by --record-path=PATH
+    ofstream gRecordPath;
+
+    // --profile times the passes of each frame on the CPU and, with
+    // GL_TIME_ELAPSED queries, on the GPU, draws the averages over the
+    // last PROFILER_WINDOW frames as bars over the scene and prints them
+    // on exit; --profile-trace=FILE also writes every pass of every frame
+    // as a Chrome trace. Passes are ProfileScope blocks. Built with
+    // PYRAMID_NO_PROFILER the scopes are empty and compile away; built
+    // without it, a scope costs one test of gProfiler.enabled while off.
+    const int PROFILER_MAX_PASSES = 16;
+    const int PROFILER_WINDOW = 120;
+
+    // Times of one pass in the last PROFILER_WINDOW frames, slot frame % PROFILER_WINDOW
+    struct ProfilerPass
+    {
+        const char* name;
+        float cpuMs[PROFILER_WINDOW];
+        float gpuMs[PROFILER_WINDOW];
+    };
+
+    // One run of a pass; its GPU time arrives frames later
+    struct ProfilerSample
+    {
+        int pass;                   // -1 past the table's end: opened and closed, never recorded
+        double cpuStart, cpuEnd;    // microseconds since the profiler started
+        GLuint query;               // 0 when the GPU was not timed (nested in a timed pass)
+    };
+
+    // Every run of every pass, for the trace
+    struct TraceEvent
+    {
+        int pass;
+        bool gpu;
+        double start, duration;     // microseconds
+    };
+
+    struct Profiler
+    {
+        bool enabled;
+        string traceFile;
+        chrono::steady_clock::time_point start;
+        ProfilerPass passes[PROFILER_MAX_PASSES];
+        int passCount;
+        long frame;
+        long gpuFrames;                             // frames whose GPU times have been collected
+        vector<ProfilerSample> open;                // passes begun and not yet ended, innermost last
+        vector<ProfilerSample> current;             // passes ended this frame
+        deque<vector<ProfilerSample>> inFlight;     // earlier frames waiting for their queries
+        deque<long> inFlightFrames;
+        vector<GLuint> freeQueries;
+        bool gpuTiming;                             // a TIME_ELAPSED query is running
+        vector<TraceEvent> trace;
+        double gpuTraceEnd;                         // end of the last GPU event on the trace
+    };
+    Profiler gProfiler = {};
+
+    // Times the block it is declared in as one pass
+#ifdef PYRAMID_NO_PROFILER
+    struct ProfileScope
+    {
+        explicit ProfileScope(const char*) {}
+    };
+#else
+    struct ProfileScope
+    {
+        explicit ProfileScope(const char* name);
+        ~ProfileScope();
+        bool active;
+    };
+#endif
+    // Triangle mesh data
+    GLMesh gMesh;
+
+    // Texture
+    GLuint gTextureId;      //toy
+    GLuint gPlanePattern;    //plane/desk
+    GLuint gSodaPattern;    //soda can
+    GLuint gCubePattern;    //supposedly ipad but will be cube
+    GLuint gCube2Pattern;   //soda tab
+
+
+
+    // A texture handed out by the texture manager
+    struct ManagedTexture
+    {
+        string path;
+        GLuint textureId;       // valid from the start, a placeholder until ready
+        bool ready;
+    };
+
+    // A read-only file mapped into memory
+    struct MappedFile
+    {
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = NULL;
+#endif
+    };
+
+    // A scene file (.pyrscene), written by --convert-obj and laid out so
+    // that, once mapped, its vertex and index blocks go to GL as they are
+    // and its tables are used in place. Every block starts on 16 bytes.
+    struct SceneFileHeader
+    {
+        char magic[8];              // "PYRSCN01"
+        uint32_t packedVertices;    // 1: PackedVertex, 0: 8 floats
+        uint32_t indexType;         // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        uint32_t meshCount, objectCount, textureCount, padding;
+        uint64_t vertexOffset, vertexBytes;     // the vertex buffer's contents
+        uint64_t indexOffset, indexBytes;       // the index buffer's contents
+        uint64_t meshOffset, objectOffset, textureOffset;
+    };
+    // A mesh within the file's buffers, and its bounding sphere
+    struct SceneFileMesh
+    {
+        MeshRange range;
+        glm::vec4 bounds;
+    };
+    // An object placed in the scene
+    struct SceneFileObject
+    {
+        uint32_t mesh;
+        int32_t texture;            // -1 for none
+        float position[3];
+        float scale;
+    };
+    // Image path relative to the scene file
+    struct SceneFileTexture
+    {
+        char path[64];
+    };
+
+    // A mapped scene file, valid until UCloseSceneFile
+    struct SceneFile
+    {
+        MappedFile mapped;
+        const SceneFileHeader* header = nullptr;
+        const SceneFileMesh* meshes = nullptr;
+        const SceneFileObject* objects = nullptr;
+        const SceneFileTexture* textures = nullptr;
+        double loadSeconds = 0.0;   // mapping and upload
+    };
+
+    // --scene=FILE draws the objects of a scene file instead of the desk;
+    // --convert-obj=FILE.obj writes one, to --scene-out=FILE or next to it
+    string gSceneFilePath;
+    SceneFile gSceneFile;
+    string gConvertObjPath, gSceneOutPath;
+
+    // Header of a cooked texture file. Every mip level follows, base
+    // first, flipped and tightly packed, ready for glTexImage2D as is.
+    struct TextureFileHeader
+    {
+        char magic[8];
+        uint64_t sourceSize;    // of the image file it was cooked from,
+        int64_t sourceTime;     // to notice when that changes
+        int32_t width, height, channels, levels;
+    };
+
+    // Cooked textures are kept here between runs; empty disables them
+    string gTextureCacheDir = "texture_cache";
+
+    // A texture prepared by a worker, waiting for upload on the GL thread.
+    // Its levels are in the mapped cache file or in cooked, see UImagePixels().
+    struct DecodedImage
+    {
+        int texture;            // index into TextureManager::textures
+        int width = 0, height = 0, channels = 0;
+        int levels = 0;
+        bool fromCache = false;
+        MappedFile mapped;
+        vector<unsigned char> cooked;
+    };
+
+    // Upload ring: each slot holds one image, every mip level of it, on
+    // its way to GL; the chain adds a third to the base level, so a slot
+    // takes up to 1024 x 1024 RGBA with room to spare
+    const int TEXTURE_PBO_SLOTS = 3;
+    const size_t TEXTURE_PBO_SLOT_SIZE = 6 * 1024 * 1024;
+
+    // Loads every texture once, decoding on worker threads and uploading
+    // through a persistently mapped pixel buffer a few images per frame
+    struct TextureManager
+    {
+        vector<ManagedTexture> textures;
+        unordered_map<string, int> byPath;
+        int sharedRequests = 0; // requests for a path already loading
+        int pending = 0;        // textures not uploaded yet
+        int failed = 0;         // left on the placeholder
+        int cacheHits = 0;      // mapped from the texture cache rather than decoded
+
+        // shared with the workers, under lock
+        vector<thread> workers;
+        mutex lock;
+        condition_variable wake;
+        deque<int> decodeQueue;
+        vector<DecodedImage> decoded;
+        bool stopping = false;
+
+        // GL thread only
+        vector<DecodedImage> uploads;
+        GLuint pbo = 0;
+        unsigned char* pboMemory = nullptr;
+        GLsync slotFences[TEXTURE_PBO_SLOTS] = {};
+        int nextSlot = 0;
+        chrono::steady_clock::time_point startTime;
+    };
+    TextureManager gTextures;
+
+    // Shader programs
+    GLuint gProgramId; //toy
+    GLuint gLampProgramId;  //lamp
+    GLuint gFillProgramId;  //fill
+    GLuint gPlaneProgramId; //plane
+    GLuint gSodaProgramId;  //soda
+    GLuint gCubeProgramId;  // cube
+    GLuint gCube2ProgramId; //cube2
+
+    glm::vec2 gUVScale(5.0f, 5.0f);
+    GLint gTexWrapMode = GL_REPEAT;
+
+    // camera
+    Camera gCamera(glm::vec3(0.0f, 0.0f, 8.0f));
+    float gLastX = WINDOW_WIDTH / 2.0f;
+    float gLastY = WINDOW_HEIGHT / 2.0f;
+    bool gFirstMouse = true;
+
+    // timing
+    float gDeltaTime = 0.0f; // time between current frame and last frame
+    float gLastFrame = 0.0f;
+
+    // --on-demand only draws a frame when something changed: input, a
+    // resize, an expose, a texture upload, or an animation in progress
+    // (a held movement key or the orbiting lamp), which is drawn at no
+    // more than --fps-cap=N frames a second; otherwise the loop sleeps in
+    // glfwWaitEvents
+    bool gOnDemand = false;
+    int gFpsCap = 60;
+    bool gNeedsRedraw = true;
+    long gIdleWaits = 0;
+    // keys held down, kept by UKeyCallback
+    bool gKeyDown[GLFW_KEY_LAST + 1] = {};
+
+    // Cube and light color
+    glm::vec3 gObjectColor(1.0f, 0.2f, 0.0f);
+
+    glm::vec3 gLightColor(1.0f, 0.9f, 1.2f);
+    glm::vec3 gFillColor(1.0f, 0.9f, 0.2f);
+
+    // Transform hierarchy in structure-of-arrays form. A node's parent
+    // always has a lower id, so ancestors are updated before descendants.
+    struct SceneGraph
+    {
+        vector<int> parent;                     // -1 for a root
+        vector<int> firstChild, nextSibling;    // -1 terminated child lists
+        vector<float> positionX, positionY, positionZ;
+        vector<float> scaleX, scaleY, scaleZ;
+        vector<glm::mat4> world;                // parent world * translate * scale
+        vector<long> updatedAt;                 // update that last recomputed world
+        vector<unsigned char> dirty;            // world is stale
+        vector<int> dirtyNodes;                 // marked since the last update
+        vector<int> updateStack;                // scratch for UUpdateSceneGraph
+        long updates;                           // UUpdateSceneGraph calls that did work
+    };
+
+    // Something drawn at a scene node
+    struct SceneObject
+    {
+        int node;
+        GLuint programId;
+        GLint modelLoc;
+        GLuint textureId;
+        MeshRange mesh;         // in gMesh's buffers, unused for a shape
+        int shape = -1;         // ShapeKind drawn at a per-frame level of detail, -1 for a fixed mesh
+        glm::vec4 bounds = glm::vec4(0.0f);     // bounding sphere in node space: centre xyz, radius w
+    };
+
+    // World-space bounding spheres of things drawn at scene nodes, as
+    // structure of arrays so the frustum test runs four spheres at a time
+    struct CullSet
+    {
+        vector<int> nodes;
+        vector<glm::vec4> localBounds;      // centre xyz, radius w, in node space
+        vector<float> centerX, centerY, centerZ, radius;
+        vector<unsigned char> visible;      // from the last UCullSpheres
+        bool changed = false;               // visible differs from the call before
+        long updatedAt = -1;                // scene graph update the world spheres reflect
+    };
+
+    // The desk scene: one root per copy, the objects as its children
+    SceneGraph gScene;
+    vector<SceneObject> gSceneObjects;
+    CullSet gObjectBounds;      // one entry per scene object
+    vector<int> gLampNodes;     // lamp of every copy; the first one lights the scene
+    int gFillNode = -1;         // fill light of the first copy
+
+    // --lod=N draws every shape at level N instead of picking by screen size
+    int gForcedLod = -1;
+    // shape draws at each level, and the vertices they cost against
+    // drawing every one at full detail
+    long gLodDraws[LOD_COUNT] = {};
+    long gShapeVertices = 0, gShapeVerticesFinest = 0;
+
+    // --no-culling draws everything, in view or not
+    bool gCulling = true;
+    // objects and instances kept and dropped by the frustum test, and its cost
+    long gObjectsVisible = 0, gObjectsCulled = 0;
+    double gCullSeconds = 0.0;
+
+
+    // Lamp animation
+    bool gLampIsOrbiting = true;
+
+    // Per-frame camera and light data; matches the std140 FrameData block,
+    // where every vec3 takes 16 bytes
+    struct FrameUniforms
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec4 viewPosition;
+        glm::vec4 lightColor;
+        glm::vec4 lightPos;
+        glm::vec4 fillColor;
+        glm::vec4 fillPos;
+    };
+    const GLuint FRAME_UBO_BINDING = 0;
+    GLuint gFrameUbo;   // written once per frame, read by every program
+
+    // Uniform locations of one program, resolved once after it is linked
+    struct GLProgramUniforms
+    {
+        GLint model;
+        GLint objectColor;
+        GLint uvScale;
+        GLint texture;
+    };
+    GLProgramUniforms gProgramUniforms;     //toy
+    GLProgramUniforms gLampUniforms;        //lamp
+    GLProgramUniforms gFillUniforms;        //fill
+    GLProgramUniforms gPlaneUniforms;       //plane
+    GLProgramUniforms gSodaUniforms;        //soda
+    GLProgramUniforms gCubeUniforms;        //cube
+    GLProgramUniforms gCube2Uniforms;       //cube2
+
+    // --copies=N draws the desk scene N x N times, to load URender
+    int gSceneCopies = 1;
+    const float SCENE_COPY_SPACING = 8.0f;
+
+    // CPU time spent issuing GL calls in URender, swap excluded
+    double gRenderCpuSeconds = 0.0;
+    long gRenderFrames = 0;
+
+    // Linked programs by hash of their shader sources, so identical
+    // vertex/fragment pairs share a single program
+    unordered_map<uint64_t, GLuint> gProgramCache;
+    // Program binaries are kept here between runs; empty disables them
+    string gShaderCacheDir = "shader_cache";
+    // What the program cache did so far
+    int gProgramsCompiled = 0;
+    int gProgramsLoaded = 0;    // from a program binary on disk
+    int gProgramsShared = 0;    // same sources as a program already made
+
+    // Per-instance data of a batched mesh (80 bytes)
+    struct MeshInstance
+    {
+        glm::mat4 model;
+        GLint textureSlot;      // index into the batch's textures
+        GLint padding[3];
+    };
+
+    // Objects sharing one mesh and program, drawn with a single instanced
+    // call; each instance picks one of the batch's textures
+    struct GLInstanceBatch
+    {
+        GLuint vao;             // the shared vertex and index buffers plus the per-instance attributes
+        GLuint instanceVbo;
+        GLuint programId;
+        MeshRange mesh;
+        GLsizei capacity;       // instances instanceVbo has room for
+        vector<GLuint> textures;        // bound to units 0.. in slot order
+        CullSet bounds;                 // scene node and bounding sphere of each instance
+        vector<GLint> textureSlots;     // texture slot of each instance
+        vector<MeshInstance> instances; // staging for the upload
+        long uploadedAt;        // scene graph update the buffer reflects
+    };
+
+    // textures one instanced program can select between
+    const int MAX_BATCH_TEXTURES = 4;
+
+    // Batches of the desk scene: lit cubes, and the lamp and fill markers
+    enum { CUBE_BATCH, MARKER_BATCH, BATCH_COUNT };
+    GLInstanceBatch gInstanceBatches[BATCH_COUNT] = {};
+    GLuint gInstancedProgramId;
+    GLuint gMarkerProgramId;
+    // --no-instancing draws every object on its own, for comparison
+    bool gInstancing = true;
+    // --cube-stress[=N] adds N textured cubes to the scene
+    int gCubeStress = 0;
+    long gInstancesDrawn = 0;
+
+    // One draw of a glMultiDrawElementsIndirect call, laid out as GL reads it
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // The whole scene as a single glMultiDrawElementsIndirect call: one
+    // command per object in view, with its model matrix and texture slot
+    // in an SSBO the shaders index with gl_DrawID. Commands and draw data
+    // are rebuilt and uploaded only when an object moved, the set in view
+    // changed or a shape switched level of detail.
+    struct GLSceneDraws
+    {
+        GLuint commandBuffer;
+        GLuint drawSsbo;        // a MeshInstance per command, slot -1 for the unlit lamp and fill
+        GLuint programId;
+        GLsizei capacity;       // commands the buffers have room for
+        vector<GLuint> textures;        // bound to units 0.. in slot order
+        vector<SceneObject> objects;
+        CullSet bounds;                 // scene node and bounding sphere of each object
+        vector<GLint> textureSlots;     // texture slot of each object
+        vector<int> lods;               // level each shape was last uploaded at
+        vector<DrawElementsIndirectCommand> commands;   // staging for the upload
+        vector<MeshInstance> draws;
+        long uploadedAt;        // scene graph update the buffers reflect
+    };
+
+    // textures the multi-draw program can select between
+    const int MULTI_DRAW_TEXTURES = 8;
+    const GLuint DRAW_SSBO_BINDING = 0;
+    GLSceneDraws gSceneDraws = {};
+    GLuint gMultiDrawProgramId;
+    // --no-multi-draw draws through the render queue and instanced batches
+    bool gMultiDraw = true;
+    long gIndirectCommands = 0, gIndirectCalls = 0;
+
+    // One draw waiting in the render queue
+    struct DrawItem
+    {
+        uint64_t key;           // sort key, see UMakeDrawKey()
+        GLuint programId;
+        GLuint textureId;       // on unit 0, 0 for none
+        GLuint vao;
+        MeshRange mesh;
+        GLint modelLoc;
+        glm::mat4 model;
+    };
+
+    // GL state last bound by the render queue, so binds that would change
+    // nothing are skipped, plus counts of the calls actually issued
+    struct GLStateCache
+    {
+        GLuint programId, textureId, vao;
+        long programBinds, textureBinds, vaoBinds, uniformUploads, draws;
+        long skippedBinds;
+    };
+
+    // Draws of the current frame, sorted by key before submission
+    vector<DrawItem> gRenderQueue;
+    GLStateCache gStateCache = {};
+    // --no-state-sort submits in scene order and binds everything, for comparison
+    bool gStateSort = true;
+
+    // Header of a program binary file; the file name carries the same
+    // source hash and driver key so other drivers' binaries sit alongside
+    struct ProgramBinaryHeader
+    {
+        char magic[8];
+        uint64_t driverKey;     // hash of vendor, renderer and version strings
+        uint64_t sourceHash;
+        GLenum format;
+        GLint length;
+    };
+
+    // Per-instance data of one bar in the bid chart (16 bytes)
+    struct BarInstance
+    {
+        GLfloat x, z;       // centre of the bar's footprint
+        GLfloat height;     // scaled bid amount
+        GLuint color;       // RGBA8, one colour per fund
+    };
+
+    // Stores the GL data of the bid bar chart (--bids mode)
+    struct GLBarChart
+    {
+        GLuint vao;             // bar geometry plus the per-instance attributes
+        GLuint vbo, ibo;        // unit bar, open at the bottom
+        GLuint instanceVbo;     // every BarInstance, uploaded once
+        GLuint programId;
+        GLsizei indexCount;
+        GLsizei instanceCount;
+        GLfloat barWidth;
+        GLint barWidthLoc, baseYLoc;
+    };
+
+    // Bid chart; empty unless started with --bids
+    GLBarChart gBarChart = {};
+
+    // Chart extent in world units, centred on the origin
+    const float CHART_WIDTH = 10.0f;
+    const float CHART_HEIGHT = 3.0f;
+    const float CHART_BASE = -0.5f;
+    // bars drawn when no --bucket is given; beyond this they are thinner
+    // than a pixel and only cost rasterisation
+    const size_t CHART_AUTO_BARS = 10000;
+}
+
+/* 
+ * initialize the program, set the window size,
+ * redraw graphics on the window when resized,
+ * and render graphics on the screen
+ */
+bool UInitialize(int, char* [], GLFWwindow** window);
+bool UInitializeHeadless();
+void UReadbackFrame();
+float UGetTime();
+bool ULoadCameraPath(BenchmarkRun& run);
+void UPlaceCamera(const vector<CameraKey>& keys, float time);
+double UGpuFrameMs(const GLuint queries[2]);
+void UBeginPass(const char* name);
+void UEndPass();
+void UEndProfileFrame();
+void UDrawProfilerOverlay();
+void UFinishProfiler();
+void UBeginGpuTimer();
+void UEndGpuTimer();
+void UFinishBenchmark();
+void UDestroyHeadless();
+void UResizeWindow(GLFWwindow* window, int width, int height);
+void UProcessInput();
+void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
+void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
+void UKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void URefreshWindow(GLFWwindow* window);
+bool UIsAnimating();
+void UWaitForFrameSlot(chrono::steady_clock::time_point frameStart);
+uint64_t UHashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+float UComputeAcmr(const vector<GLuint>& indices, size_t vertexCount);
+IndexedMesh UBuildIndexedMesh(const char* name, const GLfloat* verts, size_t vertexCount, int floatsPerVertex,
+    const GLushort* listIndices = nullptr, size_t indexCount = 0);
+GLsizei UUploadIndexedMesh(const IndexedMesh& mesh, GLuint& vbo, GLuint& ibo, GLenum& indexType);
+glm::vec4 UComputeBounds(const IndexedMesh& mesh);
+MeshRange UAppendMesh(IndexedMesh& merged, const IndexedMesh& part);
+glm::vec4 UPackVertices(const IndexedMesh& mesh, vector<PackedVertex>& packed);
+void UUnpackVertices(IndexedMesh& merged, const vector<MeshRange*>& ranges);
+glm::mat4 UDecodeMatrix(const MeshRange& mesh);
+void USetVertexFormat();
+const void* UIndexOffset(const MeshRange& mesh);
+void UCreateShapes(GLMesh& mesh, IndexedMesh& merged);
+int USelectLod(int shape, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+void UCreateMesh(GLMesh& mesh);
+void UDestroyMesh(GLMesh& mesh);
+bool UOpenSceneFile(const string& path, SceneFile& scene);
+void UCloseSceneFile(SceneFile& scene);
+void UUploadSceneGeometry(SceneFile& scene, const IndexedMesh& builtIn, GLMesh& mesh);
+void UReadObjMaterials(const filesystem::path& path, unordered_map<string, string>& diffuseMaps);
+int UConvertObj(const string& objPath, const string& outPath);
+bool UMapFile(const string& path, MappedFile& mapped);
+void UUnmapFile(MappedFile& mapped);
+void UPrepareTexture(const string& path, DecodedImage& image);
+const unsigned char* UImagePixels(const DecodedImage& image);
+void UCreateTextureManager();
+GLuint UGetTexture(const char* filename);
+void UPumpTextures();
+void UDestroyTextureManager();
+void URender();
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+void UDestroyShaderProgram(GLuint programId);
+bool UGetShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+void UDestroyShaderCache();
+int UAddSceneNode(SceneGraph& graph, int parent, const glm::vec3& position, const glm::vec3& scale);
+void USetNodePosition(SceneGraph& graph, int node, const glm::vec3& position);
+glm::vec3 UNodePosition(const SceneGraph& graph, int node);
+size_t UUpdateSceneGraph(SceneGraph& graph);
+void UCreateScene();
+void UAddSceneObject(const SceneObject& object, int batchIndex);
+void UAddCullBounds(CullSet& set, int node, const glm::vec4& bounds);
+void UUpdateCullBounds(CullSet& set, const SceneGraph& graph);
+void UExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+size_t UCullSpheres(CullSet& set, const glm::vec4 planes[6]);
+int URunCullBench(int sphereCount);
+void UCreateInstanceBatch(GLInstanceBatch& batch, const MeshRange& mesh, GLuint programId);
+void UDestroyInstanceBatch(GLInstanceBatch& batch);
+void UDrawInstanceBatches(const glm::vec4 planes[6]);
+bool UAddSceneDraw(const SceneObject& object);
+void UCreateSceneDraws(GLSceneDraws& draws, GLuint programId);
+void UDestroySceneDraws(GLSceneDraws& draws);
+void UDrawSceneIndirect(const glm::mat4& view, const glm::mat4& projection, const glm::vec4 planes[6]);
+int URunSceneStress(int nodeCount);
+void UQueueDraw(GLuint programId, GLint modelLoc, GLuint textureId, const MeshRange& mesh, const glm::mat4& model, const glm::mat4& view);
+void UFlushRenderQueue();
+GLProgramUniforms UGetProgramUniforms(GLuint programId);
+void UCreateFrameUniforms();
+void UUpdateFrameUniforms(const glm::mat4& view, const glm::mat4& projection);
+bool UCreateBarChart(const char* filename, int bucketSize, GLBarChart& chart);
+void UDestroyBarChart(GLBarChart& chart);
+void URenderBarChart();
+
+
+
+/* Cube Vertex Shader Source Code*/
+const GLchar* cubeVertexShaderSource = GLSL(440,
+
+    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+layout(location = 1) in vec3 normal; // VAP position 1 for normals
+layout(location = 2) in vec2 textureCoordinate;
+
+out vec3 vertexNormal; // For outgoing normals to fragment shader
+out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
+out vec2 vertexTextureCoordinate;
+
+//Uniform / Global variables for the  transform matrices
+uniform mat4 model;
+
+// Camera and lights, shared by every program and written once per frame
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    vec3 lightColor;
+    vec3 lightPos;
+    vec3 fillColor;
+    vec3 fillPos;
+};
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+
+    vertexFragmentPos = vec3(model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
+
+    vertexNormal = mat3(transpose(inverse(model))) * normal; // get normal vectors in world space only and exclude normal translation properties
+    vertexTextureCoordinate = textureCoordinate;
+}
+);
+
+
+/* Cube Fragment Shader Source Code*/
+const GLchar* cubeFragmentShaderSource = GLSL(440,
+
+    in vec3 vertexNormal; // For incoming normals
+in vec3 vertexFragmentPos; // For incoming fragment position
+in vec2 vertexTextureCoordinate;
+
+out vec4 fragmentColor; // For outgoing cube color to the GPU
+out vec4 fillFragmentColor;
+// Uniform / Global variables for object color and texture
+uniform vec3 objectColor;
+uniform sampler2D uTexture; // Useful when working with multiple textures
+uniform vec2 uvScale;
+
+// Light colors/positions and camera/view position, written once per frame
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    vec3 lightColor;
+    vec3 lightPos;
+    vec3 fillColor;
+    vec3 fillPos;
+};
+
+void main()
+{
+    float ambientStrength = 0.5f; // Set ambient or global lighting strength
+    vec3 ambient = ambientStrength * lightColor; // Generate ambient light color
+
+    //Calculate Diffuse lighting*/
+    vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
+    vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+    float impact = max(dot(norm, lightDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+    vec3 diffuse = impact * lightColor; // Generate diffuse light color
+
+    //Calculate Specular lighting*/
+    float specularIntensity = 0.3f; // Set specular light strength
+    float highlightSize = 2.0f; // Set specular highlight size8.0f;
+    vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
+    vec3 reflectDir = reflect(-lightDirection, norm);// Calculate reflection vector
+    //Calculate specular component
+    float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
+    vec3 specular = specularIntensity * specularComponent * lightColor;
+
+
+    //Calculate key lighting*/
+    float fillAmbientStrength = 0.1f; // Set ambient or global lighting strength
+    vec3 fillAmbient = fillAmbientStrength * fillColor; // Generate ambient light color
+
+    //Calculate Diffuse lighting*/
+
+    vec3 fillDirection = normalize(fillPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+    float fillImpact = max(dot(norm, fillDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+    vec3 fillDiffuse = fillImpact * fillColor; // Generate diffuse light color
+
+    //Calculate Specular lighting*/
+    float fillSpecularIntensity = 0.5f; // Set specular light strength
+    float fillHighlightSize = 8.0f; // Set specular highlight size
+    vec3 fillViewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
+    vec3 fillReflectDir = reflect(-fillDirection, norm);// Calculate reflection vector
+    //Calculate specular component
+    float fillSpecularComponent = pow(max(dot(fillViewDir, fillReflectDir), 0.0), fillHighlightSize);
+    vec3 fillSpecular = fillSpecularIntensity * fillSpecularComponent * fillColor;
+
+    // Calculate phong result
+    vec3 objectColor = texture(uTexture, vertexTextureCoordinate).xyz;
+    vec3 keyResult = (ambient + diffuse + specular);
+    vec3 fillResult = (fillAmbient + fillDiffuse + fillSpecular);
+    vec3 lightingResult = keyResult + fillResult;
+    vec3 phong = (lightingResult)*objectColor;
+
+
+    fragmentColor = vec4(phong, 1.0f); // Send lighting results to GPU
+}
+);
+
+
+/* Lamp Shader Source Code*/
+const GLchar* lampVertexShaderSource = GLSL(440,
+
+    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+
+        //Uniform / Global variables for the  transform matrices
+uniform mat4 model;
+
+// leading members of the per-frame block
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+};
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+}
+);
+
+
+/* Fragment Shader Source Code*/
+const GLchar* lampFragmentShaderSource = GLSL(440,
+
+    out vec4 fragmentColor; // For outgoing lamp color (smaller cube) to the GPU
+
+void main()
+{
+    fragmentColor = vec4(1.0f); // Set color to white (1.0f,1.0f,1.0f) with alpha 1.0
+}
+);
+
+
+const GLchar* fillVertexShaderSource = GLSL(440,
+
+    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+
+        //Uniform / Global variables for the  transform matrices
+uniform mat4 model;
+
+// leading members of the per-frame block
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+};
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+}
+);
+
+
+/* Fragment Shader Source Code*/
+const GLchar* fillFragmentShaderSource = GLSL(440,
+
+    out vec4 fragmentColor; // For outgoing lamp color (smaller cube) to the GPU
+
+void main()
+{
+    fragmentColor = vec4(1.0f); // Set color to white (1.0f,1.0f,1.0f) with alpha 1.0
+}
+);
+
+
+
+/* Instanced Cube Vertex Shader Source Code*/
+const GLchar* instancedVertexShaderSource = GLSL(440,
+
+    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+layout(location = 1) in vec3 normal; // VAP position 1 for normals
+layout(location = 2) in vec2 textureCoordinate;
+layout(location = 3) in mat4 model; // per instance, takes locations 3 to 6
+layout(location = 7) in int textureSlot; // per instance
+
+out vec3 vertexNormal; // For outgoing normals to fragment shader
+out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
+out vec2 vertexTextureCoordinate;
+flat out int vertexTextureSlot;
+
+// Camera and lights, shared by every program and written once per frame
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    vec3 lightColor;
+    vec3 lightPos;
+    vec3 fillColor;
+    vec3 fillPos;
+};
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+
+    vertexFragmentPos = vec3(model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
+
+    vertexNormal = mat3(transpose(inverse(model))) * normal; // get normal vectors in world space only and exclude normal translation properties
+    vertexTextureCoordinate = textureCoordinate;
+    vertexTextureSlot = textureSlot;
+}
+);
+
+
+/* Instanced Cube Fragment Shader Source Code: the cube lighting with the
+   texture picked per instance */
+const GLchar* instancedFragmentShaderSource = GLSL(440,
+
+    in vec3 vertexNormal; // For incoming normals
+in vec3 vertexFragmentPos; // For incoming fragment position
+in vec2 vertexTextureCoordinate;
+flat in int vertexTextureSlot;
+
+out vec4 fragmentColor; // For outgoing cube color to the GPU
+uniform sampler2D uTextures[4]; // one per texture slot of the batch
+
+// Light colors/positions and camera/view position, written once per frame
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    vec3 lightColor;
+    vec3 lightPos;
+    vec3 fillColor;
+    vec3 fillPos;
+};
+
+// The slot may differ between instances, so each sampler is named with a
+// constant index and the derivatives are taken outside the switch
+vec3 sampleTexture()
+{
+    vec2 dx = dFdx(vertexTextureCoordinate);
+    vec2 dy = dFdy(vertexTextureCoordinate);
+    switch (vertexTextureSlot)
+    {
+    case 1: return textureGrad(uTextures[1], vertexTextureCoordinate, dx, dy).xyz;
+    case 2: return textureGrad(uTextures[2], vertexTextureCoordinate, dx, dy).xyz;
+    case 3: return textureGrad(uTextures[3], vertexTextureCoordinate, dx, dy).xyz;
+    default: return textureGrad(uTextures[0], vertexTextureCoordinate, dx, dy).xyz;
+    }
+}
+
+void main()
+{
+    float ambientStrength = 0.5f; // Set ambient or global lighting strength
+    vec3 ambient = ambientStrength * lightColor; // Generate ambient light color
+
+    //Calculate Diffuse lighting*/
+    vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
+    vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+    float impact = max(dot(norm, lightDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+    vec3 diffuse = impact * lightColor; // Generate diffuse light color
+
+    //Calculate Specular lighting*/
+    float specularIntensity = 0.3f; // Set specular light strength
+    float highlightSize = 2.0f; // Set specular highlight size
+    vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
+    vec3 reflectDir = reflect(-lightDirection, norm);// Calculate reflection vector
+    float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
+    vec3 specular = specularIntensity * specularComponent * lightColor;
+
+    //Calculate fill lighting*/
+    float fillAmbientStrength = 0.1f; // Set ambient or global lighting strength
+    vec3 fillAmbient = fillAmbientStrength * fillColor; // Generate ambient light color
+    vec3 fillDirection = normalize(fillPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+    float fillImpact = max(dot(norm, fillDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+    vec3 fillDiffuse = fillImpact * fillColor; // Generate diffuse light color
+    float fillSpecularIntensity = 0.5f; // Set specular light strength
+    float fillHighlightSize = 8.0f; // Set specular highlight size
+    vec3 fillViewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
+    vec3 fillReflectDir = reflect(-fillDirection, norm);// Calculate reflection vector
+    float fillSpecularComponent = pow(max(dot(fillViewDir, fillReflectDir), 0.0), fillHighlightSize);
+    vec3 fillSpecular = fillSpecularIntensity * fillSpecularComponent * fillColor;
+
+    // Calculate phong result
+    vec3 objectColor = sampleTexture();
+    vec3 keyResult = (ambient + diffuse + specular);
+    vec3 fillResult = (fillAmbient + fillDiffuse + fillSpecular);
+    vec3 lightingResult = keyResult + fillResult;
+    vec3 phong = (lightingResult)*objectColor;
+
+    fragmentColor = vec4(phong, 1.0f); // Send lighting results to GPU
+}
+);
+
+
+/* Instanced lamp and fill marker Vertex Shader Source Code; they share
+   lampFragmentShaderSource */
+const GLchar* markerVertexShaderSource = GLSL(440,
+
+    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+layout(location = 3) in mat4 model; // per instance, takes locations 3 to 6
+
+// leading members of the per-frame block
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+};
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+}
+);
+
+
+/* Multi-draw Vertex Shader Source Code: each draw of the indirect call
+   finds its model matrix and texture slot at gl_DrawID */
+const GLchar* multiDrawVertexShaderSource = GLSL_EXT(440, GL_ARB_shader_draw_parameters,
+
+    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+layout(location = 1) in vec3 normal; // VAP position 1 for normals
+layout(location = 2) in vec2 textureCoordinate;
+
+out vec3 vertexNormal; // For outgoing normals to fragment shader
+out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
+out vec2 vertexTextureCoordinate;
+flat out int vertexTextureSlot;
+
+// Per-draw parameters, one MeshInstance per command
+struct DrawData
+{
+    mat4 model;
+    int textureSlot; // -1 for the unlit lamp and fill markers
+};
+layout(std430, binding = 0) readonly buffer DrawParameters
+{
+    DrawData draws[];
+};
+
+// Camera and lights, shared by every program and written once per frame
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    vec3 lightColor;
+    vec3 lightPos;
+    vec3 fillColor;
+    vec3 fillPos;
+};
+
+void main()
+{
+    mat4 model = draws[gl_DrawIDARB].model;
+    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+
+    vertexFragmentPos = vec3(model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
+
+    vertexNormal = mat3(transpose(inverse(model))) * normal; // get normal vectors in world space only and exclude normal translation properties
+    vertexTextureCoordinate = textureCoordinate;
+    vertexTextureSlot = draws[gl_DrawIDARB].textureSlot;
+}
+);
+
+
+/* Multi-draw Fragment Shader Source Code: the cube lighting with the
+   texture picked per draw, or the plain white of the lamp shader */
+const GLchar* multiDrawFragmentShaderSource = GLSL(440,
+
+    in vec3 vertexNormal; // For incoming normals
+in vec3 vertexFragmentPos; // For incoming fragment position
+in vec2 vertexTextureCoordinate;
+flat in int vertexTextureSlot;
+
+out vec4 fragmentColor; // For outgoing cube color to the GPU
+uniform sampler2D uTextures[8]; // one per texture slot of the scene
+
+// Light colors/positions and camera/view position, written once per frame
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    vec3 lightColor;
+    vec3 lightPos;
+    vec3 fillColor;
+    vec3 fillPos;
+};
+
+// The slot may differ between draws, so each sampler is named with a
+// constant index and the derivatives are taken outside the switch
+vec3 sampleTexture()
+{
+    vec2 dx = dFdx(vertexTextureCoordinate);
+    vec2 dy = dFdy(vertexTextureCoordinate);
+    switch (vertexTextureSlot)
+    {
+    case 1: return textureGrad(uTextures[1], vertexTextureCoordinate, dx, dy).xyz;
+    case 2: return textureGrad(uTextures[2], vertexTextureCoordinate, dx, dy).xyz;
+    case 3: return textureGrad(uTextures[3], vertexTextureCoordinate, dx, dy).xyz;
+    case 4: return textureGrad(uTextures[4], vertexTextureCoordinate, dx, dy).xyz;
+    case 5: return textureGrad(uTextures[5], vertexTextureCoordinate, dx, dy).xyz;
+    case 6: return textureGrad(uTextures[6], vertexTextureCoordinate, dx, dy).xyz;
+    case 7: return textureGrad(uTextures[7], vertexTextureCoordinate, dx, dy).xyz;
+    default: return textureGrad(uTextures[0], vertexTextureCoordinate, dx, dy).xyz;
+    }
+}
+
+void main()
+{
+    if (vertexTextureSlot < 0)
+    {
+        fragmentColor = vec4(1.0f); // lamp and fill markers are plain white
+        return;
+    }
+
+    float ambientStrength = 0.5f; // Set ambient or global lighting strength
+    vec3 ambient = ambientStrength * lightColor; // Generate ambient light color
+
+    //Calculate Diffuse lighting*/
+    vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
+    vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+    float impact = max(dot(norm, lightDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+    vec3 diffuse = impact * lightColor; // Generate diffuse light color
+
+    //Calculate Specular lighting*/
+    float specularIntensity = 0.3f; // Set specular light strength
+    float highlightSize = 2.0f; // Set specular highlight size
+    vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
+    vec3 reflectDir = reflect(-lightDirection, norm);// Calculate reflection vector
+    float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
+    vec3 specular = specularIntensity * specularComponent * lightColor;
+
+    //Calculate fill lighting*/
+    float fillAmbientStrength = 0.1f; // Set ambient or global lighting strength
+    vec3 fillAmbient = fillAmbientStrength * fillColor; // Generate ambient light color
+    vec3 fillDirection = normalize(fillPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+    float fillImpact = max(dot(norm, fillDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+    vec3 fillDiffuse = fillImpact * fillColor; // Generate diffuse light color
+    float fillSpecularIntensity = 0.5f; // Set specular light strength
+    float fillHighlightSize = 8.0f; // Set specular highlight size
+    vec3 fillViewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
+    vec3 fillReflectDir = reflect(-fillDirection, norm);// Calculate reflection vector
+    float fillSpecularComponent = pow(max(dot(fillViewDir, fillReflectDir), 0.0), fillHighlightSize);
+    vec3 fillSpecular = fillSpecularIntensity * fillSpecularComponent * fillColor;
+
+    // Calculate phong result
+    vec3 objectColor = sampleTexture();
+    vec3 keyResult = (ambient + diffuse + specular);
+    vec3 fillResult = (fillAmbient + fillDiffuse + fillSpecular);
+    vec3 lightingResult = keyResult + fillResult;
+    vec3 phong = (lightingResult)*objectColor;
+
+    fragmentColor = vec4(phong, 1.0f); // Send lighting results to GPU
+}
+);
+
+
+
+/* Bar chart Vertex Shader Source Code*/
+const GLchar* barVertexShaderSource = GLSL(440,
+
+    layout(location = 0) in vec3 position; // unit bar, y from 0 to 1
+layout(location = 1) in vec3 normal;
+layout(location = 3) in vec3 bar; // per instance: x, z, height
+layout(location = 4) in vec4 barColor; // per instance: fund colour
+
+out vec3 vertexNormal;
+out vec3 vertexFragmentPos;
+out vec3 vertexColor;
+
+uniform float barWidth;
+uniform float baseY;
+
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    vec3 lightColor;
+    vec3 lightPos;
+    vec3 fillColor;
+    vec3 fillPos;
+};
+
+void main()
+{
+    // scaling along the axes only, so the face normals stay valid
+    vertexFragmentPos = vec3(bar.x + position.x * barWidth, baseY + position.y * bar.z, bar.y + position.z * barWidth);
+    gl_Position = projection * view * vec4(vertexFragmentPos, 1.0f);
+    vertexNormal = normal;
+    vertexColor = barColor.rgb;
+}
+);
+
+
+/* Bar chart Fragment Shader Source Code*/
+const GLchar* barFragmentShaderSource = GLSL(440,
+
+    in vec3 vertexNormal;
+in vec3 vertexFragmentPos;
+in vec3 vertexColor;
+
+out vec4 fragmentColor;
+
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    vec3 lightColor;
+    vec3 lightPos;
+    vec3 fillColor;
+    vec3 fillPos;
+};
+
+void main()
+{
+    // ambient plus diffuse from the key and fill lights
+    vec3 norm = normalize(vertexNormal);
+    float keyImpact = max(dot(norm, normalize(lightPos - vertexFragmentPos)), 0.0);
+    float fillImpact = max(dot(norm, normalize(fillPos - vertexFragmentPos)), 0.0);
+    vec3 lighting = 0.4f * lightColor + 0.6f * keyImpact * lightColor + 0.3f * fillImpact * fillColor;
+
+    fragmentColor = vec4(lighting * vertexColor, 1.0f);
+}
+);
+
+
+int main(int argc, char* argv[])
+{
+    chrono::steady_clock::time_point startupStart = chrono::steady_clock::now();
+
+    // --bids <csv> [--bucket=N] draws the bid set as a bar chart; without
+    // --bucket the bucket size is picked to keep about CHART_AUTO_BARS bars
+    const char* bidsFilename = nullptr;
+    int bucketSize = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--bids" && i + 1 < argc)
+            bidsFilename = argv[++i];
+        else if (arg.compare(0, 9, "--bucket=") == 0)
+            bucketSize = max(1, atoi(arg.c_str() + 9));  // 1 draws every bid
+        else if (arg.compare(0, 9, "--copies=") == 0)
+            gSceneCopies = max(1, atoi(arg.c_str() + 9));
+        else if (arg.compare(0, 15, "--shader-cache=") == 0)
+            gShaderCacheDir = arg.substr(15);
+        else if (arg == "--no-shader-cache")
+            gShaderCacheDir.clear();
+        else if (arg.compare(0, 16, "--texture-cache=") == 0)
+            gTextureCacheDir = arg.substr(16);
+        else if (arg == "--no-texture-cache")
+            gTextureCacheDir.clear();
+        else if (arg == "--no-state-sort")
+            gStateSort = false;
+        else if (arg.compare(0, 6, "--lod=") == 0)
+            gForcedLod = min(max(atoi(arg.c_str() + 6), 0), LOD_COUNT - 1);
+        else if (arg == "--no-instancing")
+            gInstancing = false;
+        else if (arg == "--no-multi-draw")
+            gMultiDraw = false;
+        else if (arg == "--no-vertex-compression")
+            gCompactVertices = false;
+        else if (arg.compare(0, 13, "--cube-stress") == 0)
+            gCubeStress = max(1, arg.size() > 14 ? atoi(arg.c_str() + 14) : 100000);
+        else if (arg == "--headless")
+            gHeadless = true;
+        else if (arg == "--on-demand")
+            gOnDemand = true;
+        else if (arg.compare(0, 10, "--fps-cap=") == 0)
+            gFpsCap = max(1, atoi(arg.c_str() + 10));
+        else if (arg.compare(0, 9, "--frames=") == 0)
+            gRunFrames = max(1, atoi(arg.c_str() + 9));
+        else if (arg.compare(0, 11, "--benchmark") == 0 && (arg.size() == 11 || arg[11] == '='))
+        {
+            gBenchmark.enabled = true;
+            gBenchmark.pathFile = arg.size() > 12 ? arg.substr(12) : "";
+        }
+        else if (arg.compare(0, 16, "--benchmark-out=") == 0)
+            gBenchmark.outFile = arg.substr(16);
+        else if (arg == "--profile")
+            gProfiler.enabled = true;
+        else if (arg.compare(0, 16, "--profile-trace=") == 0)
+        {
+            gProfiler.enabled = true;
+            gProfiler.traceFile = arg.substr(16);
+        }
+        else if (arg.compare(0, 14, "--record-path=") == 0)
+            gRecordPath.open(arg.substr(14), ios::trunc);
+        else if (arg.compare(0, 10, "--capture=") == 0)
+            gCapturePrefix = arg.substr(10);
+        else if (arg.compare(0, 16, "--capture-every=") == 0)
+            gCaptureEvery = max(1, atoi(arg.c_str() + 16));
+        else if (arg == "--no-culling")
+            gCulling = false;
+        else if (arg.compare(0, 12, "--cull-bench") == 0)
+            return URunCullBench(arg.size() > 13 ? atoi(arg.c_str() + 13) : 1000000);
+        else if (arg.compare(0, 14, "--scene-stress") == 0)
+            return URunSceneStress(arg.size() > 15 ? atoi(arg.c_str() + 15) : 100000);
+        else if (arg.compare(0, 8, "--scene=") == 0)
+            gSceneFilePath = arg.substr(8);
+        else if (arg.compare(0, 14, "--convert-obj=") == 0)
+            gConvertObjPath = arg.substr(14);
+        else if (arg.compare(0, 12, "--scene-out=") == 0)
+            gSceneOutPath = arg.substr(12);
+    }
+
+    // converting an OBJ needs no window
+    if (!gConvertObjPath.empty())
+        return UConvertObj(gConvertObjPath, !gSceneOutPath.empty() ? gSceneOutPath
+            : filesystem::path(gConvertObjPath).replace_extension(".pyrscene").string());
+
+    if (gRunFrames == 0)
+        gRunFrames = gBenchmark.enabled ? 600 : gHeadless ? 100 : 0;
+    if (gBenchmark.enabled)
+    {
+        if (!ULoadCameraPath(gBenchmark))
+        {
+            cout << "Failed to load camera path " << gBenchmark.pathFile << endl;
+            return EXIT_FAILURE;
+        }
+        gBenchmark.warmupFrames = min(10L, gRunFrames / 10);
+        if (gBenchmark.outFile.empty())
+        {
+            fflush(stdout);
+            gBenchmark.reportFd = dup(fileno(stdout));
+            dup2(fileno(stderr), fileno(stdout));
+        }
+        gRunFrames += gBenchmark.warmupFrames;
+        gLampIsOrbiting = false;    // which makes URender move it
+    }
+    if (gOnDemand && (gHeadless || gBenchmark.enabled))
+    {
+        cout << "--on-demand needs a window and no benchmark; drawing every frame" << endl;
+        gOnDemand = false;
+    }
+    if (gRecordPath.is_open())
+        gRecordPath << "# time x y z yaw pitch zoom" << endl;
+
+    // A scene file stays mapped until its geometry is uploaded and its
+    // objects placed
+    if (!gSceneFilePath.empty() && !UOpenSceneFile(gSceneFilePath, gSceneFile))
+    {
+        cout << "Failed to load scene " << gSceneFilePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (gHeadless ? !UInitializeHeadless() : !UInitialize(argc, argv, &gWindow))
+        return EXIT_FAILURE;
+#ifdef PYRAMID_NO_PROFILER
+    if (gProfiler.enabled)
+        cout << "This build has no profiler (PYRAMID_NO_PROFILER)" << endl;
+    gProfiler.enabled = false;
+#endif
+    gProfiler.start = chrono::steady_clock::now();
+    if (gBenchmark.enabled)
+        glGenQueries(BENCHMARK_QUERY_SLOTS * 2, gBenchmark.queries[0]);
+
+    // Load textures; they decode in the background while everything else
+    // is set up, and show a placeholder until they are uploaded
+    UCreateTextureManager();
+    gTextureId = UGetTexture("Tex1.jpg");       //toy
+    gPlanePattern = UGetTexture("Wood1.jpg");   //plane
+    gSodaPattern = UGetTexture("Bricks.jpg");   //soda can
+    gCubePattern = UGetTexture("Blue.jpg");     //cube
+    gCube2Pattern = UGetTexture("Blue.jpg");    //cube2, the same image
+
+    // Create the mesh
+    UCreateMesh(gMesh); // Calls the function to create the Vertex Buffer Object
+
+    // Create the shader programs; objects with the same shaders get the
+    // same program, and warm starts load linked binaries from disk
+    chrono::steady_clock::time_point shaderStart = chrono::steady_clock::now();
+    if (!UGetShaderProgram(cubeVertexShaderSource, cubeFragmentShaderSource, gProgramId)) //toy
+        return EXIT_FAILURE;
+
+    if (!UGetShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gLampProgramId)) //lamp
+        return EXIT_FAILURE;
+
+    if (!UGetShaderProgram(cubeVertexShaderSource, cubeFragmentShaderSource, gPlaneProgramId))  //plane
+        return EXIT_FAILURE;
+
+    if (!UGetShaderProgram(cubeVertexShaderSource, cubeFragmentShaderSource, gSodaProgramId))  //cylinder
+        return EXIT_FAILURE;
+
+    if (!UGetShaderProgram(cubeVertexShaderSource, cubeFragmentShaderSource, gCubeProgramId))  //cube
+        return EXIT_FAILURE;
+
+    if (!UGetShaderProgram(cubeVertexShaderSource, cubeFragmentShaderSource, gCube2ProgramId))  //cube2
+        return EXIT_FAILURE;
+
+    if (!UGetShaderProgram(fillVertexShaderSource, fillFragmentShaderSource, gFillProgramId))  //fill
+        return EXIT_FAILURE;
+
+    if (!UGetShaderProgram(instancedVertexShaderSource, instancedFragmentShaderSource, gInstancedProgramId))  //batched cubes
+        return EXIT_FAILURE;
+
+    if (!UGetShaderProgram(markerVertexShaderSource, lampFragmentShaderSource, gMarkerProgramId))  //batched lamp and fill
+        return EXIT_FAILURE;
+
+    // gl_DrawID is core only from 4.6; without the extension the scene is
+    // drawn through the render queue and instanced batches instead
+    if (gMultiDraw && !GLEW_ARB_shader_draw_parameters)
+    {
+        cout << "No GL_ARB_shader_draw_parameters; drawing without multi-draw" << endl;
+        gMultiDraw = false;
+    }
+    if (gMultiDraw && !UGetShaderProgram(multiDrawVertexShaderSource, multiDrawFragmentShaderSource, gMultiDrawProgramId))  //whole scene
+        return EXIT_FAILURE;
+    double shaderSeconds = chrono::duration<double>(chrono::steady_clock::now() - shaderStart).count();
+
+    // Look up every uniform location once, now that the programs are linked
+    gProgramUniforms = UGetProgramUniforms(gProgramId);
+    gLampUniforms = UGetProgramUniforms(gLampProgramId);
+    gFillUniforms = UGetProgramUniforms(gFillProgramId);
+    gPlaneUniforms = UGetProgramUniforms(gPlaneProgramId);
+    gSodaUniforms = UGetProgramUniforms(gSodaProgramId);
+    gCubeUniforms = UGetProgramUniforms(gCubeProgramId);
+    gCube2Uniforms = UGetProgramUniforms(gCube2ProgramId);
+
+    // Camera and light uniforms shared by all programs
+    UCreateFrameUniforms();
+
+    // tell opengl for each sampler to which texture unit it belongs to, and
+    // set the per-object uniforms that never change from frame to frame
+    const GLuint litPrograms[] = { gProgramId, gPlaneProgramId, gSodaProgramId, gCubeProgramId, gCube2ProgramId };
+    const GLProgramUniforms* litUniforms[] = { &gProgramUniforms, &gPlaneUniforms, &gSodaUniforms, &gCubeUniforms, &gCube2Uniforms };
+    for (int i = 0; i < 5; ++i)
+    {
+        glUseProgram(litPrograms[i]);
+        // We set the texture as texture unit 0
+        glUniform1i(litUniforms[i]->texture, 0);
+        glUniform3f(litUniforms[i]->objectColor, gObjectColor.r, gObjectColor.g, gObjectColor.b);
+        glUniform2fv(litUniforms[i]->uvScale, 1, glm::value_ptr(gUVScale));
+    }
+
+    // instanced cubes pick their texture unit per instance
+    const GLint textureUnits[MAX_BATCH_TEXTURES] = { 0, 1, 2, 3 };
+    glUseProgram(gInstancedProgramId);
+    glUniform1iv(glGetUniformLocation(gInstancedProgramId, "uTextures"), MAX_BATCH_TEXTURES, textureUnits);
+
+    // Both batches draw the unit cube
+    UCreateInstanceBatch(gInstanceBatches[CUBE_BATCH], gMesh.cube, gInstancedProgramId);
+    UCreateInstanceBatch(gInstanceBatches[MARKER_BATCH], gMesh.cube, gMarkerProgramId);
+
+    // and the multi-draw any object with a texture unit, or none
+    if (gMultiDraw)
+    {
+        const GLint sceneUnits[MULTI_DRAW_TEXTURES] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+        glUseProgram(gMultiDrawProgramId);
+        glUniform1iv(glGetUniformLocation(gMultiDrawProgramId, "uTextures"), MULTI_DRAW_TEXTURES, sceneUnits);
+        UCreateSceneDraws(gSceneDraws, gMultiDrawProgramId);
+    }
+
+    // Place the objects
+    UCreateScene();
+    UCloseSceneFile(gSceneFile);
+
+    if (bidsFilename != nullptr && !UCreateBarChart(bidsFilename, bucketSize, gBarChart))
+    {
+        cout << "Failed to load bids " << bidsFilename << endl;
+        return EXIT_FAILURE;
+    }
+
+    // a headless or benchmark frame is only worth having with every
+    // texture in it
+    if (gHeadless || gBenchmark.enabled)
+    {
+        while (gTextures.pending > 0)
+        {
+            UPumpTextures();
+            glFlush();
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+
+    cout << "Startup: ready in " << 1000.0 * chrono::duration<double>(chrono::steady_clock::now() - startupStart).count()
+         << " ms, shaders " << 1000.0 * shaderSeconds << " ms (" << gProgramsCompiled << " compiled, "
+         << gProgramsLoaded << " from program binaries, " << gProgramsShared << " shared)" << endl;
+
+    // Sets the background color of the window to black (it will be implicitely used by glClear)
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    // frame times shown in the title bar while the chart is up
+    int chartFrames = 0;
+    float chartTitleTime = UGetTime();
+    long totalFrames = 0;
+    float firstFrame = UGetTime();
+    clock_t firstClock = clock();
+
+    // render loop
+    // -----------
+
+    while ((gRunFrames == 0 || totalFrames < gRunFrames) && (gHeadless || !glfwWindowShouldClose(gWindow)))
+    {
+        // on demand, sleep while nothing changes
+        if (gOnDemand && !gNeedsRedraw && !UIsAnimating())
+        {
+            ++gIdleWaits;
+            glfwWaitEvents();
+            continue;
+        }
+        gNeedsRedraw = false;
+
+        // per-frame timing
+        // --------------------
+        chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
+        double renderSecondsBefore = gRenderCpuSeconds;
+        float currentFrame = UGetTime();
+        gDeltaTime = gHeadless || gBenchmark.enabled ? HEADLESS_FRAME_TIME : currentFrame - gLastFrame;
+        if (gOnDemand)
+            gDeltaTime = min(gDeltaTime, 0.1f);    // the first frame after an idle spell
+        gLastFrame = currentFrame;
+
+        // input, or the camera path when benchmarking
+        // -----
+        if (gBenchmark.enabled)
+            UPlaceCamera(gBenchmark.keys, totalFrames * HEADLESS_FRAME_TIME);
+        else if (!gHeadless)
+            UProcessInput();
+        if (gRecordPath.is_open())
+            gRecordPath << currentFrame << " " << gCamera.Position.x << " " << gCamera.Position.y << " " << gCamera.Position.z
+                        << " " << gCamera.Yaw << " " << gCamera.Pitch << " " << gCamera.Zoom << "\n";
+
+        // Upload textures decoded since the last frame
+        {
+            ProfileScope scope("textures");
+            UPumpTextures();
+        }
+
+        // Render this frame
+        URender();
+        ++totalFrames;
+
+        if (gBarChart.instanceCount > 0)
+        {
+            ++chartFrames;
+            if (currentFrame - chartTitleTime >= 1.0f)
+            {
+                string title = string(WINDOW_TITLE) + " - " + to_string(gBarChart.instanceCount) + " bars - "
+                    + to_string(1000.0f * (currentFrame - chartTitleTime) / chartFrames) + " ms/frame";
+                if (!gHeadless)
+                    glfwSetWindowTitle(gWindow, title.c_str());
+                chartFrames = 0;
+                chartTitleTime = currentFrame;
+            }
+        }
+
+        if (gOnDemand)
+            UWaitForFrameSlot(frameStart);
+        else if (!gHeadless)
+            glfwPollEvents();
+
+        if (gBenchmark.enabled && totalFrames > gBenchmark.warmupFrames)
+        {
+            gBenchmark.cpuFrameMs.push_back(1000.0 * chrono::duration<double>(chrono::steady_clock::now() - frameStart).count());
+            gBenchmark.cpuRenderMs.push_back(1000.0 * (gRenderCpuSeconds - renderSecondsBefore));
+        }
+    }
+    if (gBenchmark.enabled)
+        UFinishBenchmark();
+    if (gProfiler.enabled)
+        UFinishProfiler();
+
+    if (gOnDemand)
+    {
+        float seconds = UGetTime() - firstFrame;
+        cout << "On demand: " << totalFrames << " frames drawn in " << seconds << " s (" << gIdleWaits << " idle waits), "
+             << 100.0 * (clock() - firstClock) / CLOCKS_PER_SEC / max(seconds, 0.001f) << "% of a core used" << endl;
+    }
+    if (gBarChart.instanceCount > 0 && totalFrames > 0)
+        cout << "Bar chart: " << 1000.0f * (UGetTime() - firstFrame) / totalFrames << " ms/frame over "
+             << totalFrames << " frames" << endl;
+    if (gCubeStress > 0 && totalFrames > 0)
+        cout << "Cube stress: " << gCubeStress << " cubes, " << 1000.0f * (UGetTime() - firstFrame) / totalFrames
+             << " ms/frame over " << totalFrames << " frames (" << (gInstancing ? "instanced" : "one draw per cube") << ")" << endl;
+    if (gRenderFrames > 0)
+    {
+        cout << "URender: " << 1000.0 * gRenderCpuSeconds / gRenderFrames << " ms CPU per frame over "
+             << gRenderFrames << " frames (" << gSceneCopies * gSceneCopies << " scene copies)" << endl;
+        const GLStateCache& calls = gStateCache;
+        long total = calls.programBinds + calls.textureBinds + calls.vaoBinds + calls.uniformUploads + calls.draws;
+        cout << "GL calls per frame" << (gStateSort ? " (state sorted): " : " (scene order): ") << total / gRenderFrames
+             << " = " << calls.programBinds / gRenderFrames << " programs, " << calls.textureBinds / gRenderFrames
+             << " textures, " << calls.vaoBinds / gRenderFrames << " VAOs, " << calls.uniformUploads / gRenderFrames
+             << " uniforms, " << calls.draws / gRenderFrames << " draws; " << calls.skippedBinds / gRenderFrames
+             << " redundant binds skipped" << endl;
+        if (gCulling)
+            cout << "Culling: " << gObjectsVisible / gRenderFrames << " visible, " << gObjectsCulled / gRenderFrames
+                 << " culled per frame, in " << 1000.0 * gCullSeconds / gRenderFrames << " ms" << endl;
+        if (gInstancesDrawn > 0)
+            cout << "Instanced: " << gInstancesDrawn / gRenderFrames << " instances per frame" << endl;
+        if (gIndirectCalls > 0)
+            cout << "Multi-draw: " << gIndirectCommands / gRenderFrames << " objects per frame in "
+                 << gIndirectCalls / gRenderFrames << " glMultiDrawElementsIndirect call" << endl;
+        if (gShapeVerticesFinest > 0)
+        {
+            cout << "Shape LODs per frame:";
+            for (int lod = 0; lod < LOD_COUNT; ++lod)
+                cout << " " << gLodDraws[lod] / gRenderFrames << " at " << LOD_SIDES[lod] << " sides" << (lod + 1 < LOD_COUNT ? "," : ";");
+            cout << " " << gShapeVertices / gRenderFrames << " vertices against " << gShapeVerticesFinest / gRenderFrames
+                 << " at full detail" << endl;
+        }
+    }
+    UDestroyBarChart(gBarChart);
+    for (int i = 0; i < BATCH_COUNT; ++i)
+        UDestroyInstanceBatch(gInstanceBatches[i]);
+    if (gMultiDraw)
+        UDestroySceneDraws(gSceneDraws);
+    glDeleteBuffers(1, &gFrameUbo);
+
+    // Release mesh data
+    UDestroyMesh(gMesh);
+
+    // Release textures
+    UDestroyTextureManager();
+
+    // Release shader programs; the cache owns each one exactly once
+    UDestroyShaderCache();
+
+    // Read back the frames still in flight, then drop the context
+    if (gHeadless)
+    {
+        float seconds = UGetTime() - firstFrame;
+        UDestroyHeadless();
+        const HeadlessTarget& target = gHeadlessTarget;
+        cout << "Headless: " << target.framesRendered << " frames at " << WINDOW_WIDTH << "x" << WINDOW_HEIGHT << ", "
+             << 1000.0f * seconds / max(totalFrames, 1L) << " ms/frame, " << target.framesRead << " read back, "
+             << target.imagesWritten << " images written" << endl;
+    }
+    exit(EXIT_SUCCESS); // Terminates the program successfully
+}
+
+
+// Initialize GLFW, GLEW, and create a window
+bool UInitialize(int argc, char* argv[], GLFWwindow** window)
+{
+    // GLFW: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // GLFW: window creation
+    // ---------------------
+    * window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, NULL, NULL);
+    if (*window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(*window);
+    glfwSetFramebufferSizeCallback(*window, UResizeWindow);
+    glfwSetCursorPosCallback(*window, UMousePositionCallback);
+    glfwSetScrollCallback(*window, UMouseScrollCallback);
+    glfwSetKeyCallback(*window, UKeyCallback);
+    glfwSetWindowRefreshCallback(*window, URefreshWindow);
+
+
+    // tell GLFW to capture our mouse
+    glfwSetInputMode(*window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    // GLEW: initialize
+    // ----------------
+    // Note: if using GLEW version 1.13 or earlier
+    glewExperimental = GL_TRUE;
+    GLenum GlewInitResult = glewInit();
+
+    if (GLEW_OK != GlewInitResult)
+    {
+        std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
+        return false;
+    }
+
+    // Displays GPU OpenGL version
+    cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
+
+    return true;
+}
+
+
+// process all input: react to the keys UKeyCallback saw held down this frame
+void UProcessInput()
+{
+    static const float cameraSpeed = 2.5f;
+
+
+    if (gKeyDown[GLFW_KEY_W])
+        gCamera.ProcessKeyboard(FORWARD, gDeltaTime);
+    if (gKeyDown[GLFW_KEY_S])
+        gCamera.ProcessKeyboard(BACKWARD, gDeltaTime);
+    if (gKeyDown[GLFW_KEY_A])
+        gCamera.ProcessKeyboard(LEFT, gDeltaTime);
+    if (gKeyDown[GLFW_KEY_D])
+        gCamera.ProcessKeyboard(RIGHT, gDeltaTime);
+
+
+
+    // Add stubs for Q/E Upward/Downward movement
+    if (gKeyDown[GLFW_KEY_Q])
+        gCamera.ProcessKeyboard(FORWARD, gDeltaTime);
+    if (gKeyDown[GLFW_KEY_E])
+        gCamera.ProcessKeyboard(BACKWARD, gDeltaTime);
+
+}
+
+
+// glfw: whenever a key is pressed or released, this callback is called;
+// one-shot keys act here, movement keys are only recorded for UProcessInput
+// ---------------------------------------------------------------------------
+void UKeyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/)
+{
+    if (key < 0 || key > GLFW_KEY_LAST || action == GLFW_REPEAT)
+        return;
+    gKeyDown[key] = action == GLFW_PRESS;
+    gNeedsRedraw = true;
+    if (action != GLFW_PRESS)
+        return;
+
+    if (key == GLFW_KEY_ESCAPE)
+        glfwSetWindowShouldClose(window, true);
+
+    // Pause and resume lamp orbiting
+    if (key == GLFW_KEY_L && !gLampIsOrbiting)
+        gLampIsOrbiting = true;
+    else if (key == GLFW_KEY_K && gLampIsOrbiting)
+        gLampIsOrbiting = false;
+}
+
+
+// glfw: whenever the window needs repainting (uncovered, restored), this
+// callback is called
+void URefreshWindow(GLFWwindow* /*window*/)
+{
+    gNeedsRedraw = true;
+}
+
+
+// Whether the next frame differs from the last with no new input: a
+// movement key is held, the lamp orbits, or textures wait to be uploaded
+bool UIsAnimating()
+{
+    static const int movementKeys[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E };
+    for (int key : movementKeys)
+        if (gKeyDown[key])
+            return true;
+    return !gLampIsOrbiting || gTextures.pending > 0;
+}
+
+
+// Hold an on-demand frame until the next slot of the frame rate cap,
+// handling input as it arrives
+void UWaitForFrameSlot(chrono::steady_clock::time_point frameStart)
+{
+    chrono::steady_clock::time_point due = frameStart + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0 / gFpsCap));
+    for (chrono::steady_clock::time_point now = chrono::steady_clock::now(); now < due; now = chrono::steady_clock::now())
+        glfwWaitEventsTimeout(chrono::duration<double>(due - now).count());
+    glfwPollEvents();
+}
+
+
+// Create an OpenGL 4.4 core context with no window through EGL, on the
+// surfaceless platform where there is one (Mesa, llvmpipe included), and
+// point all rendering at an offscreen framebuffer read back through PBOs
+bool UInitializeHeadless()
+{
+#ifdef _WIN32
+    cout << "Headless rendering needs EGL, which this build does not have" << endl;
+    return false;
+#else
+    HeadlessTarget& target = gHeadlessTarget;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != nullptr)
+        target.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (target.display == EGL_NO_DISPLAY)
+        target.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (target.display == EGL_NO_DISPLAY || !eglInitialize(target.display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+    {
+        cout << "Failed to initialize EGL" << endl;
+        return false;
+    }
+
+    const EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 4,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+    target.context = eglCreateContext(target.display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+    if (target.context == EGL_NO_CONTEXT || !eglMakeCurrent(target.display, EGL_NO_SURFACE, EGL_NO_SURFACE, target.context))
+    {
+        cout << "Failed to create a surfaceless OpenGL 4.4 context" << endl;
+        eglTerminate(target.display);
+        return false;
+    }
+
+    // glewInit wants a GLX display; the context alone is enough here
+    glewExperimental = GL_TRUE;
+    GLenum GlewInitResult = glewContextInit();
+    if (GLEW_OK != GlewInitResult)
+    {
+        std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
+        return false;
+    }
+    cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << " (headless, " << glGetString(GL_RENDERER) << ")" << endl;
+
+    // stand-in for the window: colour and depth at the window's size
+    glGenFramebuffers(1, &target.fbo);
+    glGenRenderbuffers(1, &target.colorRenderbuffer);
+    glGenRenderbuffers(1, &target.depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.colorRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WINDOW_WIDTH, WINDOW_HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, WINDOW_WIDTH, WINDOW_HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorRenderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depthRenderbuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        cout << "Offscreen framebuffer is incomplete" << endl;
+        return false;
+    }
+    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    glGenBuffers(READBACK_SLOTS, target.pbos);
+    for (int slot = 0; slot < READBACK_SLOTS; ++slot)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, target.pbos[slot]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, WINDOW_WIDTH * WINDOW_HEIGHT * 4, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+#endif
+}
+
+
+// Take the pixels of a finished readback and write them out if the frame
+// is one to capture, as a binary PPM with the top row first
+void UConsumeReadback(int slot)
+{
+    HeadlessTarget& target = gHeadlessTarget;
+    long frame = target.slotFrames[slot];
+    glDeleteSync(target.slotFences[slot]);
+    target.slotFences[slot] = 0;
+    target.slotFrames[slot] = 0;
+    ++target.framesRead;
+    if (gCapturePrefix.empty() || frame % gCaptureEvery != 0)
+        return;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, target.pbos[slot]);
+    const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, WINDOW_WIDTH * WINDOW_HEIGHT * 4, GL_MAP_READ_BIT);
+    if (pixels != nullptr)
+    {
+        vector<unsigned char>& row = target.row;
+        row.resize(WINDOW_WIDTH * 3);
+        char path[32];
+        snprintf(path, sizeof(path), "%05ld.ppm", frame);
+        ofstream file(gCapturePrefix + path, ios::binary | ios::trunc);
+        file << "P6\n" << WINDOW_WIDTH << " " << WINDOW_HEIGHT << "\n255\n";
+        for (int y = WINDOW_HEIGHT - 1; y >= 0; --y)
+        {
+            const unsigned char* rgba = pixels + (size_t)y * WINDOW_WIDTH * 4;
+            for (int x = 0; x < WINDOW_WIDTH; ++x)
+                memcpy(&row[x * 3], rgba + x * 4, 3);
+            file.write((const char*)row.data(), row.size());
+        }
+        if (file)
+            ++target.imagesWritten;
+        else
+            cout << "Failed to write " << gCapturePrefix + path << endl;
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+
+// Headless stand-in for swapping buffers: start copying the frame into
+// the next PBO without waiting for it. The GPU stays up to
+// READBACK_SLOTS frames ahead; a slot is only waited on when it comes
+// round again still in flight.
+void UReadbackFrame()
+{
+    HeadlessTarget& target = gHeadlessTarget;
+    int slot = target.nextSlot;
+    if (target.slotFences[slot] != 0)
+    {
+        glClientWaitSync(target.slotFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        UConsumeReadback(slot);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, target.pbos[slot]);
+    glReadPixels(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    target.slotFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    target.slotFrames[slot] = ++target.framesRendered;
+    target.nextSlot = (slot + 1) % READBACK_SLOTS;
+
+    // take whatever else has landed already, oldest first
+    for (int i = 1; i < READBACK_SLOTS; ++i)
+    {
+        int next = (target.nextSlot + i - 1) % READBACK_SLOTS;
+        if (target.slotFences[next] == 0 || glClientWaitSync(target.slotFences[next], 0, 0) == GL_TIMEOUT_EXPIRED)
+            break;
+        UConsumeReadback(next);
+    }
+}
+
+
+// Read back the frames still in flight and release the context
+void UDestroyHeadless()
+{
+#ifndef _WIN32
+    HeadlessTarget& target = gHeadlessTarget;
+    for (int i = 0; i < READBACK_SLOTS; ++i)
+    {
+        int slot = (target.nextSlot + i) % READBACK_SLOTS;
+        if (target.slotFences[slot] == 0)
+            continue;
+        glClientWaitSync(target.slotFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        UConsumeReadback(slot);
+    }
+    glDeleteBuffers(READBACK_SLOTS, target.pbos);
+    glDeleteRenderbuffers(1, &target.colorRenderbuffer);
+    glDeleteRenderbuffers(1, &target.depthRenderbuffer);
+    glDeleteFramebuffers(1, &target.fbo);
+    eglMakeCurrent(target.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(target.display, target.context);
+    eglTerminate(target.display);
+#endif
+}
+
+
+// Camera path of a benchmark: the keys in gBenchmark.pathFile, or a
+// built-in ten second orbit around the desk that dips and climbs
+bool ULoadCameraPath(BenchmarkRun& run)
+{
+    run.keys.clear();
+    if (run.pathFile.empty())
+    {
+        const float DURATION = 10.0f;
+        for (int i = 0; i <= 120; ++i)
+        {
+            float time = DURATION * i / 120.0f;
+            float angle = glm::radians(360.0f) * time / DURATION;
+            CameraKey key = { time, glm::vec3(8.0f * sin(angle), 2.0f + 1.5f * sin(2.0f * angle), 8.0f * cos(angle)), 0.0f, 0.0f, 45.0f };
+            glm::vec3 toDesk = glm::normalize(-key.position);
+            key.yaw = glm::degrees(atan2(toDesk.z, toDesk.x));
+            key.pitch = glm::degrees(asin(toDesk.y));
+            run.keys.push_back(key);
+        }
+        return true;
+    }
+
+    ifstream file(run.pathFile);
+    string line;
+    while (getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        CameraKey key;
+        if (sscanf(line.c_str(), "%f %f %f %f %f %f %f", &key.time, &key.position.x, &key.position.y, &key.position.z,
+            &key.yaw, &key.pitch, &key.zoom) == 7)
+            run.keys.push_back(key);
+    }
+    return !run.keys.empty();
+}
+
+
+// Put the camera where the path has it at time, looping the path
+void UPlaceCamera(const vector<CameraKey>& keys, float time)
+{
+    float duration = keys.back().time - keys.front().time;
+    if (duration > 0.0f)
+        time = keys.front().time + fmod(time, duration);
+    size_t next = 0;
+    while (next + 1 < keys.size() && keys[next].time <= time)
+        ++next;
+    const CameraKey& a = keys[next > 0 ? next - 1 : 0];
+    const CameraKey& b = keys[next];
+    float t = b.time > a.time ? glm::clamp((time - a.time) / (b.time - a.time), 0.0f, 1.0f) : 1.0f;
+
+    gCamera.Position = a.position + (b.position - a.position) * t;
+    gCamera.Yaw = a.yaw + (b.yaw - a.yaw) * t;
+    gCamera.Pitch = a.pitch + (b.pitch - a.pitch) * t;
+    gCamera.Zoom = a.zoom + (b.zoom - a.zoom) * t;
+    gCamera.ProcessMouseMovement(0.0f, 0.0f);   // recomputes the camera's axes
+}
+
+
+// GPU time of a frame, from the timestamps before and after it
+double UGpuFrameMs(const GLuint queries[2])
+{
+    GLuint64 start = 0, end = 0;
+    glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+    return (end - start) / 1e6;
+}
+
+
+// Time the GPU work of one frame with a pair of GL_TIMESTAMP queries;
+// unlike a TIME_ELAPSED query they leave the profiler free to time the
+// passes inside. Pairs live in a ring so their results are collected
+// frames later, when they are long done, rather than stalling the frame
+// that issued them.
+void UBeginGpuTimer()
+{
+    BenchmarkRun& run = gBenchmark;
+    int slot = run.nextQuery;
+    if (run.queryFrames[slot] != 0 && run.queryFrames[slot] > run.warmupFrames)
+        run.gpuFrameMs.push_back(UGpuFrameMs(run.queries[slot]));
+    glQueryCounter(run.queries[slot][0], GL_TIMESTAMP);
+}
+
+
+void UEndGpuTimer()
+{
+    BenchmarkRun& run = gBenchmark;
+    glQueryCounter(run.queries[run.nextQuery][1], GL_TIMESTAMP);
+    run.queryFrames[run.nextQuery] = ++run.gpuFrames;
+    run.nextQuery = (run.nextQuery + 1) % BENCHMARK_QUERY_SLOTS;
+}
+
+
+// Write "name": {min, p50, p95, p99, max, mean} of samples, in ms, picking
+// each percentile as the nearest rank
+void UWriteFrameStats(ostream& out, const char* name, vector<double> samples, bool last)
+{
+    out << "  \"" << name << "\": ";
+    if (samples.empty())
+    {
+        out << "null" << (last ? "\n" : ",\n");
+        return;
+    }
+    sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double sample : samples)
+        sum += sample;
+    auto percentile = [&](double p) { return samples[min(samples.size() - 1, (size_t)ceil(p * samples.size()) - (p > 0.0 ? 1 : 0))]; };
+    out << "{ \"min\": " << samples.front() << ", \"p50\": " << percentile(0.50) << ", \"p95\": " << percentile(0.95)
+        << ", \"p99\": " << percentile(0.99) << ", \"max\": " << samples.back() << ", \"mean\": " << sum / samples.size()
+        << " }" << (last ? "\n" : ",\n");
+}
+
+
+// Collect the GPU times still in flight and write the results as JSON,
+// to gBenchmark.outFile or the stdout set aside for it
+void UFinishBenchmark()
+{
+    BenchmarkRun& run = gBenchmark;
+    for (int i = 0; i < BENCHMARK_QUERY_SLOTS; ++i)
+    {
+        int slot = (run.nextQuery + i) % BENCHMARK_QUERY_SLOTS;
+        if (run.queryFrames[slot] == 0)
+            continue;
+        if (run.queryFrames[slot] > run.warmupFrames)
+            run.gpuFrameMs.push_back(UGpuFrameMs(run.queries[slot]));
+        run.queryFrames[slot] = 0;
+    }
+    glDeleteQueries(BENCHMARK_QUERY_SLOTS * 2, run.queries[0]);
+
+    ofstream file;
+    ostringstream report;
+    if (!run.outFile.empty())
+        file.open(run.outFile, ios::trunc);
+    ostream& out = run.outFile.empty() ? (ostream&)report : file;
+    string path;
+    for (char c : run.pathFile.empty() ? string("built-in orbit") : run.pathFile)
+        path += c == '"' || c == '\\' ? string("\\") + c : string(1, c);
+    out << "{\n  \"path\": \"" << path << "\",\n  \"frames\": " << run.cpuFrameMs.size() << ",\n  \"warmup_frames\": "
+        << run.warmupFrames << ",\n  \"scene_copies\": " << gSceneCopies * gSceneCopies << ",\n  \"headless\": "
+        << (gHeadless ? "true" : "false") << ",\n";
+    UWriteFrameStats(out, "cpu_frame_ms", run.cpuFrameMs, false);
+    UWriteFrameStats(out, "cpu_render_ms", run.cpuRenderMs, false);
+    UWriteFrameStats(out, "gpu_frame_ms", run.gpuFrameMs, true);
+    out << "}" << endl;
+    if (!run.outFile.empty() && !file)
+        cout << "Failed to write " << run.outFile << endl;
+    if (run.outFile.empty())
+    {
+        FILE* stdoutFile = fdopen(run.reportFd, "w");
+        if (stdoutFile != nullptr)
+        {
+            fwrite(report.str().data(), 1, report.str().size(), stdoutFile);
+            fclose(stdoutFile);
+        }
+    }
+}
+
+
+#ifndef PYRAMID_NO_PROFILER
+ProfileScope::ProfileScope(const char* name)
+{
+    active = gProfiler.enabled;
+    if (active)
+        UBeginPass(name);
+}
+
+
+ProfileScope::~ProfileScope()
+{
+    if (active)
+        UEndPass();
+}
+#endif
+
+
+double UProfilerMicroseconds()
+{
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - gProfiler.start).count();
+}
+
+
+// Start timing pass name. Only the outermost open pass is timed on the
+// GPU, since TIME_ELAPSED queries cannot nest.
+void UBeginPass(const char* name)
+{
+    Profiler& profiler = gProfiler;
+    int pass = 0;
+    while (pass < profiler.passCount && profiler.passes[pass].name != name)
+        ++pass;
+    if (pass == profiler.passCount)
+    {
+        if (pass == PROFILER_MAX_PASSES)
+        {
+            // still opened, so that its UEndPass does not close the enclosing pass
+            profiler.open.push_back({ -1, 0.0, 0.0, 0 });
+            return;
+        }
+        profiler.passes[pass] = {};
+        profiler.passes[pass].name = name;
+        ++profiler.passCount;
+    }
+
+    ProfilerSample sample = { pass, UProfilerMicroseconds(), 0.0, 0 };
+    if (!profiler.gpuTiming)
+    {
+        if (profiler.freeQueries.empty())
+        {
+            GLuint query;
+            glGenQueries(1, &query);
+            profiler.freeQueries.push_back(query);
+        }
+        sample.query = profiler.freeQueries.back();
+        profiler.freeQueries.pop_back();
+        glBeginQuery(GL_TIME_ELAPSED, sample.query);
+        profiler.gpuTiming = true;
+    }
+    profiler.open.push_back(sample);
+}
+
+
+void UEndPass()
+{
+    Profiler& profiler = gProfiler;
+    if (profiler.open.empty())
+        return;
+    ProfilerSample sample = profiler.open.back();
+    profiler.open.pop_back();
+    if (sample.pass < 0)
+        return;
+    sample.cpuEnd = UProfilerMicroseconds();
+    if (sample.query != 0)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        profiler.gpuTiming = false;
+    }
+    profiler.passes[sample.pass].cpuMs[profiler.frame % PROFILER_WINDOW] += (float)((sample.cpuEnd - sample.cpuStart) / 1000.0);
+    profiler.current.push_back(sample);
+    if (!profiler.traceFile.empty())
+        profiler.trace.push_back({ sample.pass, false, sample.cpuStart, sample.cpuEnd - sample.cpuStart });
+}
+
+
+// Collect the GPU times of earlier frames whose queries are done, oldest
+// first, and stop at the first that is not: queries finish in order, so
+// nothing ever waits on the GPU
+void UCollectGpuTimes(bool wait)
+{
+    Profiler& profiler = gProfiler;
+    while (!profiler.inFlight.empty())
+    {
+        vector<ProfilerSample>& samples = profiler.inFlight.front();
+        GLuint last = 0;
+        for (const ProfilerSample& sample : samples)
+            last = sample.query != 0 ? sample.query : last;
+        GLuint available = GL_TRUE;
+        if (last != 0 && !wait)
+            glGetQueryObjectuiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        int slot = (int)(profiler.inFlightFrames.front() % PROFILER_WINDOW);
+        for (int pass = 0; pass < profiler.passCount; ++pass)
+            profiler.passes[pass].gpuMs[slot] = 0.0f;
+        for (const ProfilerSample& sample : samples)
+        {
+            if (sample.query == 0)
+                continue;
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(sample.query, GL_QUERY_RESULT, &nanoseconds);
+            if (nanoseconds > 1000000000ull)
+                nanoseconds = 0;    // no pass takes a second; llvmpipe's first query can claim hours
+            profiler.passes[sample.pass].gpuMs[slot] += (float)(nanoseconds / 1e6);
+            profiler.freeQueries.push_back(sample.query);
+            if (!profiler.traceFile.empty())
+            {
+                // the GPU track shows each pass from when it was submitted,
+                // or when the GPU finished the pass before it
+                double start = max(sample.cpuStart, profiler.gpuTraceEnd);
+                profiler.trace.push_back({ sample.pass, true, start, nanoseconds / 1000.0 });
+                profiler.gpuTraceEnd = start + nanoseconds / 1000.0;
+            }
+        }
+        profiler.inFlight.pop_front();
+        profiler.inFlightFrames.pop_front();
+        ++profiler.gpuFrames;
+    }
+}
+
+
+// Close the frame's passes and start the next one
+void UEndProfileFrame()
+{
+    Profiler& profiler = gProfiler;
+    profiler.inFlight.push_back(move(profiler.current));
+    profiler.inFlightFrames.push_back(profiler.frame);
+    profiler.current.clear();
+    UCollectGpuTimes(false);
+
+    ++profiler.frame;
+    int slot = (int)(profiler.frame % PROFILER_WINDOW);
+    for (int pass = 0; pass < profiler.passCount; ++pass)
+        profiler.passes[pass].cpuMs[slot] = 0.0f;
+}
+
+
+// Mean CPU and GPU ms per frame of a pass over the window. GPU times lag
+// by the frames still in flight, so they average over the frames collected;
+// until a slot is first collected it holds zero and adds nothing.
+void UPassAverages(const ProfilerPass& pass, float& cpuMs, float& gpuMs)
+{
+    int frames = (int)min<long>(gProfiler.frame, PROFILER_WINDOW);
+    int gpuFrames = (int)min<long>(gProfiler.gpuFrames, PROFILER_WINDOW);
+    cpuMs = gpuMs = 0.0f;
+    for (int i = 0; i < frames; ++i)
+        cpuMs += pass.cpuMs[i];
+    for (int i = 0; i < PROFILER_WINDOW; ++i)
+        gpuMs += pass.gpuMs[i];
+    if (frames > 0)
+        cpuMs /= frames;
+    if (gpuFrames > 0)
+        gpuMs /= gpuFrames;
+}
+
+
+// Two bars per pass in the top left corner, CPU above GPU, in the pass's
+// colour against a 16.7 ms background, drawn with scissored clears so no
+// GL state beyond the clear colour and scissor box is touched
+void UDrawProfilerOverlay()
+{
+    static const float COLORS[][3] = { { 0.9f, 0.3f, 0.3f }, { 0.3f, 0.9f, 0.3f }, { 0.3f, 0.5f, 1.0f }, { 0.9f, 0.9f, 0.3f },
+        { 0.9f, 0.4f, 0.9f }, { 0.3f, 0.9f, 0.9f }, { 1.0f, 0.6f, 0.2f }, { 0.7f, 0.7f, 0.7f } };
+    const float PIXELS_PER_MS = 300.0f / 16.7f;
+    const int BAR = 5, LEFT = 10;
+
+    glEnable(GL_SCISSOR_TEST);
+    int top = WINDOW_HEIGHT - 10;
+    for (int pass = 0; pass < gProfiler.passCount; ++pass)
+    {
+        float cpuMs, gpuMs;
+        UPassAverages(gProfiler.passes[pass], cpuMs, gpuMs);
+        const float* color = COLORS[pass % 8];
+        glScissor(LEFT, top - 2 * BAR, 300, 2 * BAR);
+        glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glClearColor(color[0], color[1], color[2], 1.0f);
+        glScissor(LEFT, top - BAR, max(1, (int)(cpuMs * PIXELS_PER_MS)), BAR);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glClearColor(color[0] * 0.6f, color[1] * 0.6f, color[2] * 0.6f, 1.0f);
+        glScissor(LEFT, top - 2 * BAR, max(1, (int)(gpuMs * PIXELS_PER_MS)), BAR);
+        glClear(GL_COLOR_BUFFER_BIT);
+        top -= 2 * BAR + 3;
+    }
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+
+// Wait for the last GPU times, print the pass averages and write the
+// trace if one was asked for
+void UFinishProfiler()
+{
+    Profiler& profiler = gProfiler;
+    UCollectGpuTimes(true);
+    cout << "Profile over the last " << min<long>(profiler.frame, PROFILER_WINDOW) << " frames (bar colours in order: red, green, "
+         << "blue, yellow, magenta, cyan, orange, grey):" << endl;
+    for (int pass = 0; pass < profiler.passCount; ++pass)
+    {
+        float cpuMs, gpuMs;
+        UPassAverages(profiler.passes[pass], cpuMs, gpuMs);
+        printf("  %-14s CPU %8.3f ms  GPU %8.3f ms\n", profiler.passes[pass].name, cpuMs, gpuMs);
+    }
+
+    if (!profiler.traceFile.empty())
+    {
+        ofstream file(profiler.traceFile, ios::trunc);
+        file << "{\"traceEvents\":[\n"
+             << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n"
+             << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+        for (const TraceEvent& event : profiler.trace)
+            file << ",\n{\"name\":\"" << profiler.passes[event.pass].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1)
+                 << ",\"ts\":" << fixed << event.start << ",\"dur\":" << event.duration << "}";
+        file << "\n]}" << endl;
+        if (file)
+            cout << "Profile trace: " << profiler.trace.size() << " events written to " << profiler.traceFile << endl;
+        else
+            cout << "Failed to write " << profiler.traceFile << endl;
+    }
+    for (const vector<ProfilerSample>& samples : profiler.inFlight)
+        for (const ProfilerSample& sample : samples)
+            if (sample.query != 0)
+                profiler.freeQueries.push_back(sample.query);
+    if (!profiler.freeQueries.empty())
+        glDeleteQueries((GLsizei)profiler.freeQueries.size(), profiler.freeQueries.data());
+}
+
+
+// Seconds since startup, from GLFW when there is a window
+float UGetTime()
+{
+    static const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (!gHeadless)
+        return (float)glfwGetTime();
+    return chrono::duration<float>(chrono::steady_clock::now() - start).count();
+}
+
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+void UResizeWindow(GLFWwindow* window, int width, int height)
+{
+    glViewport(0, 0, width, height);
+    gNeedsRedraw = true;
+}
+
+
+// glfw: whenever the mouse moves, this callback is called
+// -------------------------------------------------------
+void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
+{
+    if (gFirstMouse)
+    {
+        gLastX = xpos;
+        gLastY = ypos;
+        gFirstMouse = false;
+    }
+
+    float xoffset = xpos - gLastX;
+    float yoffset = gLastY - ypos; // reversed since y-coordinates go from bottom to top
+
+    gLastX = xpos;
+    gLastY = ypos;
+
+    gCamera.ProcessMouseMovement(xoffset, yoffset);
+    gNeedsRedraw = true;
+}
+
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    gCamera.ProcessMouseScroll(yoffset);
+    gNeedsRedraw = true;
+}
+
+// glfw: handle mouse button events
+// --------------------------------
+
+
+
+// Functioned called to render a frame
+void URender()
+{
+    chrono::steady_clock::time_point cpuStart = chrono::steady_clock::now();
+
+    // Lamp orbits around the origin
+    const float angularVelocity = glm::radians(45.0f);
+    if (!gLampIsOrbiting)
+    {
+        glm::mat4 orbit = glm::rotate(angularVelocity * gDeltaTime, glm::vec3(0.0f, 1.0f, 0.0f));
+        for (size_t i = 0; i < gLampNodes.size(); ++i)
+        {
+            glm::vec4 newPosition = orbit * glm::vec4(UNodePosition(gScene, gLampNodes[i]), 1.0f);
+            USetNodePosition(gScene, gLampNodes[i], glm::vec3(newPosition));
+        }
+    }
+
+    // Refresh the world matrices of whatever moved
+    {
+        ProfileScope scope("scene update");
+        UUpdateSceneGraph(gScene);
+    }
+
+    if (gBenchmark.enabled)
+        UBeginGpuTimer();
+
+    // Enable z-depth
+    glEnable(GL_DEPTH_TEST);
+
+    // Clear the frame and z buffers
+    {
+        ProfileScope scope("clear");
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // camera/view transformation
+    glm::mat4 view = gCamera.GetViewMatrix();
+
+    // Creates a perspective projection
+    glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+
+    // Camera and light data go to the GPU once, for every program
+    UUpdateFrameUniforms(view, projection);
+
+    // what the camera can see, for culling
+    glm::vec4 planes[6];
+    UExtractFrustumPlanes(projection * view, planes);
+
+    // The bid chart replaces the desk scene
+    if (gBarChart.instanceCount > 0)
+    {
+        ProfileScope scope("bar chart");
+        URenderBarChart();
+    }
+    else
+    {
+        // Queue every object in view, then draw them sorted by state. Per
+        // object only the model matrix changes; its location was looked up
+        // when the program was linked
+        {
+            ProfileScope scope("cull and queue");
+            if (gCulling)
+            {
+                chrono::steady_clock::time_point cullStart = chrono::steady_clock::now();
+                UUpdateCullBounds(gObjectBounds, gScene);
+                size_t visible = UCullSpheres(gObjectBounds, planes);
+                gObjectsVisible += visible;
+                gObjectsCulled += gSceneObjects.size() - visible;
+                gCullSeconds += chrono::duration<double>(chrono::steady_clock::now() - cullStart).count();
+            }
+            gRenderQueue.clear();
+            for (size_t i = 0; i < gSceneObjects.size(); ++i)
+            {
+                if (!gObjectBounds.visible[i])
+                    continue;
+                const SceneObject& object = gSceneObjects[i];
+                const glm::mat4& model = gScene.world[object.node];
+                if (object.shape < 0)
+                {
+                    UQueueDraw(object.programId, object.modelLoc, object.textureId, object.mesh, model, view);
+                    continue;
+                }
+
+                // shapes: fewer sides the smaller they are on screen
+                int lod = USelectLod(object.shape, model, view, projection);
+                const MeshRange& range = gMesh.shapeLods[object.shape][lod];
+                UQueueDraw(object.programId, object.modelLoc, object.textureId, range, model, view);
+                ++gLodDraws[lod];
+                gShapeVertices += range.vertexCount;
+                gShapeVerticesFinest += gMesh.shapeLods[object.shape][0].vertexCount;
+            }
+        }
+        {
+            ProfileScope scope("draw queue");
+            UFlushRenderQueue();
+        }
+        {
+            ProfileScope scope("instanced");
+            UDrawInstanceBatches(planes);
+        }
+        {
+            ProfileScope scope("multi-draw");
+            UDrawSceneIndirect(view, projection, planes);
+        }
+    }
+
+    // Deactivate the Vertex Array Object and shader program
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    if (gBenchmark.enabled)
+        UEndGpuTimer();
+    if (gProfiler.enabled)
+        UDrawProfilerOverlay();
+
+    gRenderCpuSeconds += chrono::duration<double>(chrono::steady_clock::now() - cpuStart).count();
+    ++gRenderFrames;
+
+    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+    {
+        ProfileScope scope("present");
+        if (gHeadless)
+            UReadbackFrame();   // no window: copy the frame out instead
+        else
+            glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+    }
+    if (gProfiler.enabled)
+        UEndProfileFrame();
+
+
+}
+
+
+// Add a node under parent (-1 for a root); its world matrix is computed
+// by the next UUpdateSceneGraph
+int UAddSceneNode(SceneGraph& graph, int parent, const glm::vec3& position, const glm::vec3& scale)
+{
+    int node = (int)graph.parent.size();
+    graph.parent.push_back(parent);
+    graph.firstChild.push_back(-1);
+    graph.nextSibling.push_back(-1);
+    if (parent >= 0)
+    {
+        graph.nextSibling[node] = graph.firstChild[parent];
+        graph.firstChild[parent] = node;
+    }
+    graph.positionX.push_back(position.x);
+    graph.positionY.push_back(position.y);
+    graph.positionZ.push_back(position.z);
+    graph.scaleX.push_back(scale.x);
+    graph.scaleY.push_back(scale.y);
+    graph.scaleZ.push_back(scale.z);
+    graph.world.push_back(glm::mat4(1.0f));
+    graph.updatedAt.push_back(0);
+    graph.dirty.push_back(1);
+    graph.dirtyNodes.push_back(node);
+    return node;
+}
+
+
+void USetNodePosition(SceneGraph& graph, int node, const glm::vec3& position)
+{
+    graph.positionX[node] = position.x;
+    graph.positionY[node] = position.y;
+    graph.positionZ[node] = position.z;
+    if (!graph.dirty[node])
+    {
+        graph.dirty[node] = 1;
+        graph.dirtyNodes.push_back(node);
+    }
+}
+
+
+// Position of a node relative to its parent
+glm::vec3 UNodePosition(const SceneGraph& graph, int node)
+{
+    return glm::vec3(graph.positionX[node], graph.positionY[node], graph.positionZ[node]);
+}
+
+
+// world = parent world * translate(position) * scale(scale). With only
+// translation and scale that is three scaled columns and one weighted
+// sum of columns, each column in one SSE register.
+inline void UComputeWorldMatrix(SceneGraph& graph, int node)
+{
+    static const glm::mat4 IDENTITY(1.0f);
+    int parent = graph.parent[node];
+    const float* p = glm::value_ptr(parent >= 0 ? graph.world[parent] : IDENTITY);
+    float* w = glm::value_ptr(graph.world[node]);
+    float x = graph.positionX[node], y = graph.positionY[node], z = graph.positionZ[node];
+
+#if defined(__SSE__) || defined(_M_X64)
+    __m128 c0 = _mm_loadu_ps(p);
+    __m128 c1 = _mm_loadu_ps(p + 4);
+    __m128 c2 = _mm_loadu_ps(p + 8);
+    __m128 c3 = _mm_loadu_ps(p + 12);
+    _mm_storeu_ps(w, _mm_mul_ps(c0, _mm_set1_ps(graph.scaleX[node])));
+    _mm_storeu_ps(w + 4, _mm_mul_ps(c1, _mm_set1_ps(graph.scaleY[node])));
+    _mm_storeu_ps(w + 8, _mm_mul_ps(c2, _mm_set1_ps(graph.scaleZ[node])));
+    __m128 t = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(x)), _mm_mul_ps(c1, _mm_set1_ps(y)));
+    _mm_storeu_ps(w + 12, _mm_add_ps(t, _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(z)), c3)));
+#else
+    for (int row = 0; row < 4; ++row)
+    {
+        w[row] = p[row] * graph.scaleX[node];
+        w[4 + row] = p[4 + row] * graph.scaleY[node];
+        w[8 + row] = p[8 + row] * graph.scaleZ[node];
+        w[12 + row] = p[row] * x + p[4 + row] * y + p[8 + row] * z + p[12 + row];
+    }
+#endif
+}
+
+
+// Recompute world matrices for the nodes marked dirty and everything
+// below them, and nothing else, so the cost follows the number of
+// changes rather than the size of the graph
+// @return number of world matrices recomputed
+size_t UUpdateSceneGraph(SceneGraph& graph)
+{
+    if (graph.dirtyNodes.empty())
+        return 0;
+
+    // ancestors have lower ids: sorted, each dirty subtree is reached
+    // from its topmost dirty node and marked clean on the way down
+    sort(graph.dirtyNodes.begin(), graph.dirtyNodes.end());
+    ++graph.updates;
+    size_t updated = 0;
+    vector<int>& stack = graph.updateStack;
+    for (size_t i = 0; i < graph.dirtyNodes.size(); ++i)
+    {
+        int root = graph.dirtyNodes[i];
+        if (!graph.dirty[root])
+            continue;   // already refreshed under a dirty ancestor
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            int node = stack.back();
+            stack.pop_back();
+            UComputeWorldMatrix(graph, node);
+            graph.updatedAt[node] = graph.updates;
+            graph.dirty[node] = 0;
+            ++updated;
+            for (int child = graph.firstChild[node]; child >= 0; child = graph.nextSibling[child])
+                stack.push_back(child);
+        }
+    }
+    graph.dirtyNodes.clear();
+    return updated;
+}
+
+
+// Build the desk scene, gSceneCopies x gSceneCopies times over
+void UCreateScene()
+{
+    // textures of a scene file's objects, found next to the file
+    vector<GLuint> sceneTextures;
+    for (uint32_t i = 0; gSceneFile.header != nullptr && i < gSceneFile.header->textureCount; ++i)
+        sceneTextures.push_back(UGetTexture((filesystem::path(gSceneFilePath).parent_path() / gSceneFile.textures[i].path).string().c_str()));
+
+    for (int copy = 0; copy < gSceneCopies * gSceneCopies; ++copy)
+    {
+        int root = UAddSceneNode(gScene, -1, glm::vec3((copy % gSceneCopies) * SCENE_COPY_SPACING, 0.0f,
+            -(copy / gSceneCopies) * SCENE_COPY_SPACING), glm::vec3(1.0f));
+
+        // a scene file's objects take the place of the desk's
+        if (gSceneFile.header != nullptr)
+        {
+            for (uint32_t i = 0; i < gSceneFile.header->objectCount; ++i)
+            {
+                const SceneFileObject& placed = gSceneFile.objects[i];
+                const SceneFileMesh& fileMesh = gSceneFile.meshes[placed.mesh];
+                SceneObject object = { UAddSceneNode(gScene, root, glm::make_vec3(placed.position), glm::vec3(placed.scale)),
+                    gProgramId, gProgramUniforms.model, placed.texture >= 0 ? sceneTextures[placed.texture] : gTextureId, fileMesh.range };
+                object.bounds = fileMesh.bounds;
+                UAddSceneObject(object, -1);
+            }
+        }
+        else
+        {
+            // position (pyramid)
+            SceneObject toy = { UAddSceneNode(gScene, root, glm::vec3(3.0f, -0.65f, 2.0f), glm::vec3(0.85f)),
+                gProgramId, gProgramUniforms.model, gTextureId, gMesh.toy };
+            //Desk pad position (plane)
+            SceneObject plane = { UAddSceneNode(gScene, root, glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(3.0f)),
+                gPlaneProgramId, gPlaneUniforms.model, gPlanePattern, gMesh.plane };
+            //cylinder position
+            SceneObject soda = { UAddSceneNode(gScene, root, glm::vec3(-2.0f, -0.32f, 2.0f), glm::vec3(3.0f)),
+                gSodaProgramId, gSodaUniforms.model, gSodaPattern, MeshRange(), SHAPE_CYLINDER };
+            //cube position
+            SceneObject cube = { UAddSceneNode(gScene, root, glm::vec3(0.75f, -0.1f, -1.0f), glm::vec3(2.0f)),
+                gCubeProgramId, gCubeUniforms.model, gCubePattern, gMesh.cube };
+            //cube 2 position
+            SceneObject cube2 = { UAddSceneNode(gScene, root, glm::vec3(-2.0f, 0.4f, 1.9f), glm::vec3(0.3f)),
+                gCube2ProgramId, gCube2Uniforms.model, gCube2Pattern, gMesh.cube };
+
+            toy.bounds = gMesh.toyBounds;
+            plane.bounds = gMesh.planeBounds;
+            soda.bounds = glm::vec4(0.0f, 0.0f, 0.0f, gMesh.shapeRadius[SHAPE_CYLINDER]);
+            cube.bounds = cube2.bounds = gMesh.cubeBounds;
+
+            UAddSceneObject(toy, -1);
+            UAddSceneObject(plane, -1);
+            UAddSceneObject(soda, -1);
+            UAddSceneObject(cube, CUBE_BATCH);
+            UAddSceneObject(cube2, CUBE_BATCH);
+        }
+
+        // The lamp and fill markers are unit cubes
+        SceneObject lamp = { UAddSceneNode(gScene, root, glm::vec3(4.0f, 5.5f, 3.0f), glm::vec3(1.3f)),
+            gLampProgramId, gLampUniforms.model, 0, gMesh.cube };
+        SceneObject fill = { UAddSceneNode(gScene, root, glm::vec3(-8.0f, 11.5f, 7.0f), glm::vec3(1.3f)),
+            gFillProgramId, gFillUniforms.model, 0, gMesh.cube };
+        lamp.bounds = fill.bounds = gMesh.cubeBounds;
+        UAddSceneObject(lamp, MARKER_BATCH);
+        UAddSceneObject(fill, MARKER_BATCH);
+        gLampNodes.push_back(lamp.node);
+        if (copy == 0)
+            gFillNode = fill.node;
+    }
+
+    // --cube-stress: a square field of small cubes in front of the desk,
+    // alternating between the two cube textures
+    if (gCubeStress > 0)
+    {
+        const int side = (int)ceil(sqrt((double)gCubeStress));
+        const float spacing = 0.25f;
+        int root = UAddSceneNode(gScene, -1, glm::vec3(-0.5f * side * spacing, -0.4f, 3.0f), glm::vec3(1.0f));
+        for (int i = 0; i < gCubeStress; ++i)
+        {
+            SceneObject cube = { UAddSceneNode(gScene, root, glm::vec3((i % side) * spacing, 0.0f, -(i / side) * spacing), glm::vec3(0.15f)),
+                gCubeProgramId, gCubeUniforms.model, i % 2 ? gCube2Pattern : gCubePattern, gMesh.cube };
+            cube.bounds = gMesh.cubeBounds;
+            UAddSceneObject(cube, CUBE_BATCH);
+        }
+    }
+    for (size_t i = 0; i < gSceneObjects.size(); ++i)
+        UAddCullBounds(gObjectBounds, gSceneObjects[i].node, gSceneObjects[i].bounds);
+    UUpdateSceneGraph(gScene);
+}
+
+
+// Put an object in the scene's multi-draw, else in the batch for its mesh
+// (batchIndex, -1 for none), or else in the per-object list when
+// instancing is off or the batch has no texture slot left for it
+void UAddSceneObject(const SceneObject& object, int batchIndex)
+{
+    if (gMultiDraw && UAddSceneDraw(object))
+        return;
+    if (batchIndex < 0)
+    {
+        gSceneObjects.push_back(object);
+        return;
+    }
+
+    GLInstanceBatch& batch = gInstanceBatches[batchIndex];
+    GLint slot = 0;
+    if (object.textureId != 0)
+    {
+        slot = (GLint)(find(batch.textures.begin(), batch.textures.end(), object.textureId) - batch.textures.begin());
+        if (slot == (GLint)batch.textures.size() && slot < MAX_BATCH_TEXTURES && gInstancing)
+            batch.textures.push_back(object.textureId);
+    }
+    if (!gInstancing || slot >= MAX_BATCH_TEXTURES)
+    {
+        gSceneObjects.push_back(object);
+        return;
+    }
+    UAddCullBounds(batch.bounds, object.node, object.bounds);
+    batch.textureSlots.push_back(slot);
+}
+
+
+// Set up an instanced batch drawing one mesh of the shared buffers
+void UCreateInstanceBatch(GLInstanceBatch& batch, const MeshRange& mesh, GLuint programId)
+{
+    batch.programId = programId;
+    batch.mesh = mesh;
+
+    glGenVertexArrays(1, &batch.vao);
+    glBindVertexArray(batch.vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, gMesh.vbo);
+    USetVertexFormat();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gMesh.ibo);
+
+    // the model matrix takes four attribute slots, one per column; these
+    // and the texture slot advance once per instance
+    glGenBuffers(1, &batch.instanceVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVbo);
+    for (int column = 0; column < 4; ++column)
+    {
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance),
+            (void*)(offsetof(MeshInstance, model) + sizeof(glm::vec4) * column));
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribDivisor(3 + column, 1);
+    }
+    glVertexAttribIPointer(7, 1, GL_INT, sizeof(MeshInstance), (void*)offsetof(MeshInstance, textureSlot));
+    glEnableVertexAttribArray(7);
+    glVertexAttribDivisor(7, 1);
+
+    glBindVertexArray(0);
+}
+
+
+void UDestroyInstanceBatch(GLInstanceBatch& batch)
+{
+    glDeleteVertexArrays(1, &batch.vao);
+    glDeleteBuffers(1, &batch.instanceVbo);
+}
+
+
+// One instanced draw per batch, of the instances in view. Instance data
+// is rebuilt and uploaded only when a world matrix in the batch or the
+// set of instances in view changed since the last upload.
+void UDrawInstanceBatches(const glm::vec4 planes[6])
+{
+    for (int b = 0; b < BATCH_COUNT; ++b)
+    {
+        GLInstanceBatch& batch = gInstanceBatches[b];
+        CullSet& bounds = batch.bounds;
+        GLsizei total = (GLsizei)bounds.nodes.size();
+        if (total == 0)
+            continue;
+
+        bool moved = false;
+        for (GLsizei i = 0; i < total && !moved; ++i)
+            moved = gScene.updatedAt[bounds.nodes[i]] > batch.uploadedAt;
+        if (gCulling)
+        {
+            chrono::steady_clock::time_point cullStart = chrono::steady_clock::now();
+            UUpdateCullBounds(bounds, gScene);
+            size_t visible = UCullSpheres(bounds, planes);
+            gObjectsVisible += visible;
+            gObjectsCulled += total - visible;
+            gCullSeconds += chrono::duration<double>(chrono::steady_clock::now() - cullStart).count();
+            moved |= bounds.changed;
+        }
+        if (moved)
+        {
+            batch.instances.clear();
+            for (GLsizei i = 0; i < total; ++i)
+            {
+                if (!bounds.visible[i])
+                    continue;
+                MeshInstance instance = {};
+                instance.model = gScene.world[bounds.nodes[i]] * UDecodeMatrix(batch.mesh);
+                instance.textureSlot = batch.textureSlots[i];
+                batch.instances.push_back(instance);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVbo);
+            if (batch.instances.size() > (size_t)batch.capacity)
+            {
+                glBufferData(GL_ARRAY_BUFFER, batch.instances.size() * sizeof(MeshInstance), batch.instances.data(), GL_DYNAMIC_DRAW);
+                batch.capacity = (GLsizei)batch.instances.size();
+            }
+            else
+                glBufferSubData(GL_ARRAY_BUFFER, 0, batch.instances.size() * sizeof(MeshInstance), batch.instances.data());
+            batch.uploadedAt = gScene.updates;
+        }
+        GLsizei count = (GLsizei)batch.instances.size();
+        if (count == 0)
+            continue;
+
+        glUseProgram(batch.programId);
+        for (size_t t = 0; t < batch.textures.size(); ++t)
+        {
+            glActiveTexture(GL_TEXTURE0 + (GLenum)t);
+            glBindTexture(GL_TEXTURE_2D, batch.textures[t]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glBindVertexArray(batch.vao);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, batch.mesh.indexCount, gMesh.indexType, UIndexOffset(batch.mesh), count,
+            batch.mesh.baseVertex);
+
+        GLStateCache& cache = gStateCache;
+        ++cache.programBinds;
+        cache.textureBinds += (long)batch.textures.size();
+        ++cache.vaoBinds;
+        ++cache.draws;
+        gInstancesDrawn += count;
+    }
+    // the render queue's view of the bindings is stale now
+    gStateCache.programId = gStateCache.textureId = gStateCache.vao = ~0u;
+}
+
+
+// Add an object to the scene's multi-draw; false when the draw has no
+// texture slot left for it. Objects with no texture are the lamp and fill
+// markers, drawn unlit.
+bool UAddSceneDraw(const SceneObject& object)
+{
+    GLSceneDraws& draws = gSceneDraws;
+    GLint slot = -1;
+    if (object.textureId != 0)
+    {
+        slot = (GLint)(find(draws.textures.begin(), draws.textures.end(), object.textureId) - draws.textures.begin());
+        if (slot == MULTI_DRAW_TEXTURES)
+            return false;
+        if (slot == (GLint)draws.textures.size())
+            draws.textures.push_back(object.textureId);
+    }
+    draws.objects.push_back(object);
+    draws.textureSlots.push_back(slot);
+    draws.lods.push_back(-1);
+    UAddCullBounds(draws.bounds, object.node, object.bounds);
+    return true;
+}
+
+
+// Create the command buffer and draw-parameter SSBO of the scene's
+// multi-draw; they grow to fit on the first upload
+void UCreateSceneDraws(GLSceneDraws& draws, GLuint programId)
+{
+    draws.programId = programId;
+    draws.uploadedAt = -1;
+    glGenBuffers(1, &draws.commandBuffer);
+    glGenBuffers(1, &draws.drawSsbo);
+}
+
+
+void UDestroySceneDraws(GLSceneDraws& draws)
+{
+    glDeleteBuffers(1, &draws.commandBuffer);
+    glDeleteBuffers(1, &draws.drawSsbo);
+}
+
+
+// Every object of the multi-draw in one glMultiDrawElementsIndirect call,
+// whatever its mesh, texture or level of detail
+void UDrawSceneIndirect(const glm::mat4& view, const glm::mat4& projection, const glm::vec4 planes[6])
+{
+    GLSceneDraws& draws = gSceneDraws;
+    CullSet& bounds = draws.bounds;
+    GLsizei total = (GLsizei)draws.objects.size();
+    if (total == 0)
+        return;
+
+    bool changed = false;
+    for (GLsizei i = 0; i < total && !changed; ++i)
+        changed = gScene.updatedAt[bounds.nodes[i]] > draws.uploadedAt;
+    if (gCulling)
+    {
+        chrono::steady_clock::time_point cullStart = chrono::steady_clock::now();
+        UUpdateCullBounds(bounds, gScene);
+        size_t visible = UCullSpheres(bounds, planes);
+        gObjectsVisible += visible;
+        gObjectsCulled += total - visible;
+        gCullSeconds += chrono::duration<double>(chrono::steady_clock::now() - cullStart).count();
+        changed |= bounds.changed;
+    }
+
+    // shapes: fewer sides the smaller they are on screen
+    for (GLsizei i = 0; i < total; ++i)
+    {
+        const SceneObject& object = draws.objects[i];
+        if (object.shape < 0 || !bounds.visible[i])
+            continue;
+        int lod = USelectLod(object.shape, gScene.world[object.node], view, projection);
+        changed |= lod != draws.lods[i];
+        draws.lods[i] = lod;
+        ++gLodDraws[lod];
+        gShapeVertices += gMesh.shapeLods[object.shape][lod].vertexCount;
+        gShapeVerticesFinest += gMesh.shapeLods[object.shape][0].vertexCount;
+    }
+
+    if (changed)
+    {
+        draws.commands.clear();
+        draws.draws.clear();
+        for (GLsizei i = 0; i < total; ++i)
+        {
+            if (!bounds.visible[i])
+                continue;
+            const SceneObject& object = draws.objects[i];
+            const MeshRange& mesh = object.shape < 0 ? object.mesh : gMesh.shapeLods[object.shape][draws.lods[i]];
+            DrawElementsIndirectCommand command = { (GLuint)mesh.indexCount, 1, mesh.firstIndex, mesh.baseVertex, 0 };
+            draws.commands.push_back(command);
+            MeshInstance instance = {};
+            instance.model = gScene.world[object.node] * UDecodeMatrix(mesh);
+            instance.textureSlot = draws.textureSlots[i];
+            draws.draws.push_back(instance);
+        }
+        GLsizei count = (GLsizei)draws.commands.size();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draws.commandBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, draws.drawSsbo);
+        if (count > draws.capacity)
+        {
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, count * sizeof(DrawElementsIndirectCommand), draws.commands.data(), GL_DYNAMIC_DRAW);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(MeshInstance), draws.draws.data(), GL_DYNAMIC_DRAW);
+            draws.capacity = count;
+        }
+        else if (count > 0)
+        {
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, count * sizeof(DrawElementsIndirectCommand), draws.commands.data());
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(MeshInstance), draws.draws.data());
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        draws.uploadedAt = gScene.updates;
+    }
+    GLsizei count = (GLsizei)draws.commands.size();
+    if (count == 0)
+        return;
+
+    glUseProgram(draws.programId);
+    for (size_t t = 0; t < draws.textures.size(); ++t)
+    {
+        glActiveTexture(GL_TEXTURE0 + (GLenum)t);
+        glBindTexture(GL_TEXTURE_2D, draws.textures[t]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(gMesh.vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draws.commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_SSBO_BINDING, draws.drawSsbo);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, gMesh.indexType, NULL, count, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    GLStateCache& cache = gStateCache;
+    ++cache.programBinds;
+    cache.textureBinds += (long)draws.textures.size();
+    ++cache.vaoBinds;
+    ++cache.draws;
+    gIndirectCommands += count;
+    ++gIndirectCalls;
+    // the render queue's view of the bindings is stale now
+    cache.programId = cache.textureId = cache.vao = ~0u;
+}
+
+
+// Track something drawn at node with the node-space bounding sphere
+// bounds; its world sphere is filled in by the next UUpdateCullBounds
+void UAddCullBounds(CullSet& set, int node, const glm::vec4& bounds)
+{
+    set.nodes.push_back(node);
+    set.localBounds.push_back(bounds);
+    set.centerX.push_back(0.0f);
+    set.centerY.push_back(0.0f);
+    set.centerZ.push_back(0.0f);
+    set.radius.push_back(0.0f);
+    set.visible.push_back(1);
+    set.updatedAt = -1;
+}
+
+
+// Move the world spheres of a set along with the nodes that were
+// recomputed since it was last refreshed
+void UUpdateCullBounds(CullSet& set, const SceneGraph& graph)
+{
+    if (set.updatedAt == graph.updates)
+        return;
+    for (size_t i = 0; i < set.nodes.size(); ++i)
+    {
+        int node = set.nodes[i];
+        if (graph.updatedAt[node] <= set.updatedAt)
+            continue;
+        const glm::mat4& world = graph.world[node];
+        const glm::vec4& local = set.localBounds[i];
+        glm::vec4 center = world * glm::vec4(local.x, local.y, local.z, 1.0f);
+        float scale = max(glm::length(glm::vec3(world[0])), max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+        set.centerX[i] = center.x;
+        set.centerY[i] = center.y;
+        set.centerZ[i] = center.z;
+        set.radius[i] = local.w * scale;
+    }
+    set.updatedAt = graph.updates;
+}
+
+
+// The six planes bounding what viewProjection can see, pointing inwards
+// and normalised so a point's signed distance is dot(plane, (p, 1))
+void UExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; ++row)
+        rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        planes[2 * axis] = rows[3] + rows[axis];        // left, bottom, near
+        planes[2 * axis + 1] = rows[3] - rows[axis];    // right, top, far
+    }
+    for (int i = 0; i < 6; ++i)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+
+// Mark each sphere of the set visible unless it lies wholly outside one
+// of the planes, and note whether that changed anything since the last
+// call. A sphere is in view when its nearest plane is less than its
+// radius away, so the planes only take a running minimum, for four or
+// eight spheres at a time.
+// @return number of visible spheres
+size_t UCullSpheres(CullSet& set, const glm::vec4 planes[6])
+{
+    size_t count = set.nodes.size();
+    size_t visible = 0;
+    bool changed = false;
+    size_t i = 0;
+
+#if defined(__SSE__) || defined(_M_X64)
+    // visible bytes for each 4-bit mask, as one little-endian word
+    static const uint32_t MASK_BYTES[16] = { 0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001,
+        0x00010100, 0x00010101, 0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101 };
+#if defined(__AVX2__) && defined(__FMA__)
+    __m256 a8[6], b8[6], c8[6], d8[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        a8[p] = _mm256_set1_ps(planes[p].x);
+        b8[p] = _mm256_set1_ps(planes[p].y);
+        c8[p] = _mm256_set1_ps(planes[p].z);
+        d8[p] = _mm256_set1_ps(planes[p].w);
+    }
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(&set.centerX[i]);
+        __m256 y = _mm256_loadu_ps(&set.centerY[i]);
+        __m256 z = _mm256_loadu_ps(&set.centerZ[i]);
+        __m256 nearest = _mm256_fmadd_ps(c8[0], z, _mm256_fmadd_ps(b8[0], y, _mm256_fmadd_ps(a8[0], x, d8[0])));
+        for (int p = 1; p < 6; ++p)
+            nearest = _mm256_min_ps(nearest, _mm256_fmadd_ps(c8[p], z, _mm256_fmadd_ps(b8[p], y, _mm256_fmadd_ps(a8[p], x, d8[p]))));
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(nearest, _mm256_loadu_ps(&set.radius[i])), _mm256_setzero_ps(), _CMP_GE_OQ));
+        uint32_t bytes[2] = { MASK_BYTES[mask & 15], MASK_BYTES[mask >> 4] };
+        changed |= memcmp(&set.visible[i], bytes, 8) != 0;
+        memcpy(&set.visible[i], bytes, 8);
+        visible += MASK_BYTES[mask & 15] * 0x01010101u >> 24;
+        visible += MASK_BYTES[mask >> 4] * 0x01010101u >> 24;
+    }
+#endif
+    __m128 a[6], b[6], c[6], d[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        a[p] = _mm_set1_ps(planes[p].x);
+        b[p] = _mm_set1_ps(planes[p].y);
+        c[p] = _mm_set1_ps(planes[p].z);
+        d[p] = _mm_set1_ps(planes[p].w);
+    }
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&set.centerX[i]);
+        __m128 y = _mm_loadu_ps(&set.centerY[i]);
+        __m128 z = _mm_loadu_ps(&set.centerZ[i]);
+        __m128 nearest = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], x), _mm_mul_ps(b[0], y)), _mm_add_ps(_mm_mul_ps(c[0], z), d[0]));
+        for (int p = 1; p < 6; ++p)
+            nearest = _mm_min_ps(nearest, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[p], x), _mm_mul_ps(b[p], y)), _mm_add_ps(_mm_mul_ps(c[p], z), d[p])));
+        int mask = _mm_movemask_ps(_mm_cmpge_ps(_mm_add_ps(nearest, _mm_loadu_ps(&set.radius[i])), _mm_setzero_ps()));
+        changed |= memcmp(&set.visible[i], &MASK_BYTES[mask], 4) != 0;
+        memcpy(&set.visible[i], &MASK_BYTES[mask], 4);
+        visible += MASK_BYTES[mask] * 0x01010101u >> 24;     // sum of the four bytes
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        float nearest = FLT_MAX;
+        for (int p = 0; p < 6; ++p)
+            nearest = min(nearest, planes[p].x * set.centerX[i] + planes[p].y * set.centerY[i] + planes[p].z * set.centerZ[i] + planes[p].w);
+        unsigned char inside = nearest + set.radius[i] >= 0.0f;
+        changed |= set.visible[i] != inside;
+        set.visible[i] = inside;
+        visible += inside;
+    }
+    set.changed = changed;
+    return visible;
+}
+
+
+// --cull-bench[=N]: time the frustum test over N spheres scattered
+// around the camera, without opening a window
+int URunCullBench(int sphereCount)
+{
+    sphereCount = max(sphereCount, 1);
+    SceneGraph graph;
+    CullSet set;
+    mt19937 random(12345);
+    uniform_real_distribution<float> offset(-100.0f, 100.0f);
+    for (int i = 0; i < sphereCount; ++i)
+    {
+        int node = UAddSceneNode(graph, -1, glm::vec3(offset(random), 0.1f * offset(random), offset(random)), glm::vec3(1.0f));
+        UAddCullBounds(set, node, glm::vec4(0.0f, 0.0f, 0.0f, 0.5f));
+    }
+    UUpdateSceneGraph(graph);
+    UUpdateCullBounds(set, graph);
+
+    glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+    glm::vec4 planes[6];
+    UExtractFrustumPlanes(projection * gCamera.GetViewMatrix(), planes);
+
+    const int RUNS = 50;
+    size_t visible = UCullSpheres(set, planes);     // warm the caches
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int run = 0; run < RUNS; ++run)
+        visible = UCullSpheres(set, planes);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / RUNS;
+    cout << "Cull bench: " << sphereCount << " spheres, " << visible << " visible, " << sphereCount - visible
+         << " culled, in " << 1000.0 * seconds << " ms" << endl;
+    return EXIT_SUCCESS;
+}
+
+
+// --scene-stress[=N]: time world matrix updates on an N-node graph for
+// growing numbers of moved nodes, without opening a window
+int URunSceneStress(int nodeCount)
+{
+    nodeCount = max(nodeCount, 1);
+    SceneGraph graph;
+    mt19937 random(12345);
+    uniform_real_distribution<float> offset(-1.0f, 1.0f);
+
+    // 8-ary tree, added breadth first so parents precede children
+    for (int i = 0; i < nodeCount; ++i)
+        UAddSceneNode(graph, i == 0 ? -1 : (i - 1) / 8, glm::vec3(offset(random), offset(random), offset(random)), glm::vec3(1.0f));
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    size_t updated = UUpdateSceneGraph(graph);
+    cout << "Scene stress: " << nodeCount << " nodes, first update " << updated << " matrices in "
+         << 1000.0 * chrono::duration<double>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+
+    const int FRAMES = 50;
+    const int changeCounts[] = { 0, 1, 10, 100, 1000, 10000, nodeCount };
+    for (int changes : changeCounts)
+    {
+        if (changes > nodeCount)
+            continue;
+        double seconds = 0.0;
+        size_t matrices = 0;
+        for (int frame = 0; frame < FRAMES; ++frame)
+        {
+            for (int i = 0; i < changes; ++i)
+            {
+                int node = changes == nodeCount ? i : (int)(random() % nodeCount);
+                USetNodePosition(graph, node, UNodePosition(graph, node) + glm::vec3(0.001f));
+            }
+            start = chrono::steady_clock::now();
+            matrices += UUpdateSceneGraph(graph);
+            seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+        cout << "  " << changes << " moved nodes: " << 1e6 * seconds / FRAMES << " us/frame, "
+             << matrices / FRAMES << " matrices/frame" << endl;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+// Build the 64-bit sort key of a draw: program in the top 16 bits, then
+// texture, then VAO, so equal state ends up adjacent, and view depth in
+// the low 16 bits so each state group draws front to back
+uint64_t UMakeDrawKey(GLuint programId, GLuint textureId, GLuint vao, float viewDepth)
+{
+    const float FAR_PLANE = 100.0f;
+    uint64_t depth = (uint64_t)(glm::clamp(viewDepth / FAR_PLANE, 0.0f, 1.0f) * 65535.0f);
+    return ((uint64_t)(programId & 0xffff) << 48) | ((uint64_t)(textureId & 0xffff) << 32)
+        | ((uint64_t)(vao & 0xffff) << 16) | depth;
+}
+
+
+// Add one draw to this frame's render queue
+void UQueueDraw(GLuint programId, GLint modelLoc, GLuint textureId, const MeshRange& mesh, const glm::mat4& model, const glm::mat4& view)
+{
+    DrawItem item;
+    item.programId = programId;
+    item.textureId = textureId;
+    item.vao = gMesh.vao;
+    item.mesh = mesh;
+    item.modelLoc = modelLoc;
+    item.model = model;
+    // distance in front of the camera of the object's origin
+    item.key = UMakeDrawKey(programId, textureId, item.vao, -(view * model[3]).z);
+    gRenderQueue.push_back(item);
+}
+
+
+// Sort the queue by key and draw it, binding program, texture and VAO
+// only when they differ from what is already bound
+void UFlushRenderQueue()
+{
+    if (gStateSort)
+        sort(gRenderQueue.begin(), gRenderQueue.end(), [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+
+    // other code binds behind the cache's back, so start every frame clean
+    GLStateCache& cache = gStateCache;
+    cache.programId = cache.textureId = cache.vao = ~0u;
+
+    for (size_t i = 0; i < gRenderQueue.size(); ++i)
+    {
+        const DrawItem& item = gRenderQueue[i];
+        if (item.programId != cache.programId || !gStateSort)
+        {
+            glUseProgram(item.programId);
+            cache.programId = item.programId;
+            ++cache.programBinds;
+        }
+        else
+            ++cache.skippedBinds;
+
+        if (item.textureId != cache.textureId || !gStateSort)
+        {
+            glBindTexture(GL_TEXTURE_2D, item.textureId);
+            cache.textureId = item.textureId;
+            ++cache.textureBinds;
+        }
+        else
+            ++cache.skippedBinds;
+
+        if (item.vao != cache.vao || !gStateSort)
+        {
+            glBindVertexArray(item.vao);
+            cache.vao = item.vao;
+            ++cache.vaoBinds;
+        }
+        else
+            ++cache.skippedBinds;
+
+        glm::mat4 model = item.model * UDecodeMatrix(item.mesh);
+        glUniformMatrix4fv(item.modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+        ++cache.uniformUploads;
+
+        glDrawElementsBaseVertex(GL_TRIANGLES, item.mesh.indexCount, gMesh.indexType, UIndexOffset(item.mesh), item.mesh.baseVertex);
+        ++cache.draws;
+    }
+}
+
+
+// Create the per-frame uniform buffer and attach it to the FrameData
+// binding point every program declares
+void UCreateFrameUniforms()
+{
+    glGenBuffers(1, &gFrameUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, gFrameUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UBO_BINDING, gFrameUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+
+// Write this frame's camera and light data in a single upload
+void UUpdateFrameUniforms(const glm::mat4& view, const glm::mat4& projection)
+{
+    FrameUniforms frame;
+    frame.view = view;
+    frame.projection = projection;
+    frame.viewPosition = glm::vec4(gCamera.Position, 1.0f);
+    frame.lightColor = glm::vec4(gLightColor, 1.0f);
+    frame.lightPos = gScene.world[gLampNodes[0]][3];
+    frame.fillColor = glm::vec4(gFillColor, 1.0f);
+    frame.fillPos = gScene.world[gFillNode][3];
+
+    glBindBuffer(GL_UNIFORM_BUFFER, gFrameUbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+
+// Simulated FIFO post-transform cache: average transformed vertices per
+// triangle (ACMR), 3.0 with no reuse at all
+float UComputeAcmr(const vector<GLuint>& indices, size_t vertexCount)
+{
+    if (indices.empty())
+        return 0.0f;
+    vector<size_t> cachedAt(vertexCount, SIZE_MAX);     // miss count when it entered the cache
+    size_t misses = 0;
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        GLuint v = indices[i];
+        if (cachedAt[v] == SIZE_MAX || misses - cachedAt[v] >= VERTEX_CACHE_SIZE)
+            cachedAt[v] = misses++;
+    }
+    return (float)misses / (indices.size() / 3);
+}
+
+
+// Merge vertices whose every attribute is bit-identical. Triangle lists
+// written out by hand repeat each shared corner once per triangle.
+void UWeldVertices(const GLfloat* verts, size_t vertexCount, int floatsPerVertex, const vector<GLuint>& listIndices,
+    IndexedMesh& mesh)
+{
+    // open addressing over the welded vertices, hashed on their bytes
+    size_t tableSize = 16;
+    while (tableSize < vertexCount * 2)
+        tableSize *= 2;
+    vector<GLuint> table(tableSize, ~0u);
+    vector<GLuint> remap(vertexCount);
+    const size_t vertexBytes = sizeof(GLfloat) * floatsPerVertex;
+
+    mesh.vertices.clear();
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        const GLfloat* vertex = verts + v * floatsPerVertex;
+        size_t slot = UHashBytes(vertex, vertexBytes) & (tableSize - 1);
+        while (table[slot] != ~0u && memcmp(&mesh.vertices[table[slot] * floatsPerVertex], vertex, vertexBytes) != 0)
+            slot = (slot + 1) & (tableSize - 1);
+        if (table[slot] == ~0u)
+        {
+            table[slot] = (GLuint)(mesh.vertices.size() / floatsPerVertex);
+            mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + floatsPerVertex);
+        }
+        remap[v] = table[slot];
+    }
+
+    mesh.indices.resize(listIndices.size());
+    for (size_t i = 0; i < listIndices.size(); ++i)
+        mesh.indices[i] = remap[listIndices[i]];
+}
+
+
+// Forsyth's linear-speed vertex cache optimisation: repeatedly emit the
+// best-scoring triangle, where a vertex scores higher the more recently
+// it was used and the fewer triangles it has left
+void UOptimizeVertexCache(vector<GLuint>& indices, size_t vertexCount)
+{
+    const size_t triangleCount = indices.size() / 3;
+    const int CACHE = VERTEX_CACHE_SIZE;
+
+    // triangles using each vertex, as offsets into one array
+    vector<GLuint> remaining(vertexCount, 0), firstTriangle(vertexCount + 1, 0);
+    for (size_t i = 0; i < indices.size(); ++i)
+        ++remaining[indices[i]];
+    for (size_t v = 0; v < vertexCount; ++v)
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    vector<GLuint> vertexTriangles(indices.size());
+    vector<GLuint> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+        vertexTriangles[fill[indices[i]]++] = (GLuint)(i / 3);
+
+    auto vertexScore = [&](int cachePosition, GLuint trianglesLeft)
+    {
+        if (trianglesLeft == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+            score = cachePosition < 3 ? 0.75f : powf(1.0f - (cachePosition - 3) / (float)(CACHE - 3), 1.5f);
+        return score + 2.0f / sqrtf((float)trianglesLeft);
+    };
+
+    vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        score[v] = vertexScore(-1, remaining[v]);
+    vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    vector<unsigned char> emitted(triangleCount, 0);
+    vector<GLuint> output;
+    output.reserve(indices.size());
+    vector<GLuint> cache, nextCache;
+    size_t scanFrom = 0;
+    int best = -1;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        // nothing in the cache leads anywhere: take the best triangle left
+        if (best < 0)
+        {
+            float bestScore = -1.0f;
+            while (scanFrom < triangleCount && emitted[scanFrom])
+                ++scanFrom;
+            for (size_t t = scanFrom; t < triangleCount; ++t)
+            {
+                if (!emitted[t] && triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = (int)t;
+                }
+            }
+        }
+
+        emitted[best] = 1;
+        const GLuint* triangle = &indices[best * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+
+        // the triangle's vertices move to the front of the LRU cache
+        nextCache.assign(triangle, triangle + 3);
+        for (GLuint v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        for (int k = 0; k < 3; ++k)
+        {
+            GLuint v = triangle[k];
+            --remaining[v];
+            GLuint* list = &vertexTriangles[firstTriangle[v]];
+            GLuint* end = list + remaining[v] + 1;
+            *find(list, end, (GLuint)best) = end[-1];    // drop it from the vertex's list
+        }
+
+        // vertices pushed out of the cache score as uncached again
+        for (size_t i = CACHE; i < nextCache.size(); ++i)
+            score[nextCache[i]] = vertexScore(-1, remaining[nextCache[i]]);
+        nextCache.resize(min(nextCache.size(), (size_t)CACHE));
+
+        // rescore what is still cached, then pick the best triangle among
+        // the ones they touch
+        for (size_t i = 0; i < nextCache.size(); ++i)
+            score[nextCache[i]] = vertexScore((int)i, remaining[nextCache[i]]);
+        best = -1;
+        float bestScore = -1.0f;
+        for (GLuint v : nextCache)
+        {
+            for (GLuint i = 0; i < remaining[v]; ++i)
+            {
+                GLuint t = vertexTriangles[firstTriangle[v] + i];
+                triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = (int)t;
+                }
+            }
+        }
+        cache.swap(nextCache);
+    }
+    indices.swap(output);
+}
+
+
+// Overdraw pass after the cache pass, as in Tipsify: cut the triangles
+// into clusters wherever the simulated cache starts over, then draw the
+// clusters that face away from the mesh centre first, as they are the
+// most likely to hide the rest
+void UOptimizeOverdraw(vector<GLuint>& indices, const vector<GLfloat>& vertices, int floatsPerVertex)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+    auto position = [&](GLuint v) { return glm::make_vec3(&vertices[v * floatsPerVertex]); };
+
+    // cluster starts: triangles whose three vertices all miss the cache
+    vector<size_t> clusterStart;
+    vector<size_t> cachedAt(vertices.size() / floatsPerVertex, SIZE_MAX);
+    size_t misses = 0;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        int triangleMisses = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            GLuint v = indices[t * 3 + k];
+            if (cachedAt[v] == SIZE_MAX || misses - cachedAt[v] >= VERTEX_CACHE_SIZE)
+            {
+                cachedAt[v] = misses++;
+                ++triangleMisses;
+            }
+        }
+        if (triangleMisses == 3)
+            clusterStart.push_back(t);
+    }
+    clusterStart.push_back(triangleCount);
+    if (clusterStart.size() <= 2)
+        return;
+
+    glm::vec3 meshCentre(0.0f);
+    for (size_t i = 0; i < indices.size(); ++i)
+        meshCentre += position(indices[i]);
+    meshCentre /= (float)indices.size();
+
+    // how far out, along its average normal, each cluster sits
+    vector<pair<float, size_t>> order;
+    for (size_t c = 0; c + 1 < clusterStart.size(); ++c)
+    {
+        glm::vec3 centre(0.0f), normal(0.0f);
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t)
+        {
+            glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), d = position(indices[t * 3 + 2]);
+            centre += a + b + d;
+            normal += glm::cross(b - a, d - a);
+        }
+        centre /= 3.0f * (clusterStart[c + 1] - clusterStart[c]);
+        float length = glm::length(normal);
+        order.push_back(make_pair(length > 0.0f ? -glm::dot(centre - meshCentre, normal / length) : 0.0f, c));
+    }
+    stable_sort(order.begin(), order.end());
+
+    vector<GLuint> output;
+    output.reserve(indices.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        size_t c = order[i].second;
+        output.insert(output.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+    }
+    indices.swap(output);
+}
+
+
+// Weld, index and reorder a mesh, and report what it did to the vertex
+// count and the cache. listIndices may be null for a plain triangle list.
+IndexedMesh UBuildIndexedMesh(const char* name, const GLfloat* verts, size_t vertexCount, int floatsPerVertex,
+    const GLushort* listIndices, size_t indexCount)
+{
+    vector<GLuint> original(listIndices != nullptr ? indexCount : vertexCount);
+    for (size_t i = 0; i < original.size(); ++i)
+        original[i] = listIndices != nullptr ? listIndices[i] : (GLuint)i;
+
+    IndexedMesh mesh;
+    UWeldVertices(verts, vertexCount, floatsPerVertex, original, mesh);
+    size_t weldedCount = mesh.vertices.size() / floatsPerVertex;
+    float acmrBefore = UComputeAcmr(original, vertexCount);
+
+    // generated meshes may already be in a better order than the greedy
+    // pass finds; keep whichever simulates better
+    vector<GLuint> welded = mesh.indices;
+    UOptimizeVertexCache(mesh.indices, weldedCount);
+    float acmrCache = UComputeAcmr(mesh.indices, weldedCount);
+    if (acmrCache > UComputeAcmr(welded, weldedCount))
+    {
+        mesh.indices.swap(welded);
+        acmrCache = UComputeAcmr(mesh.indices, weldedCount);
+    }
+    UOptimizeOverdraw(mesh.indices, mesh.vertices, floatsPerVertex);
+
+    mesh.indexType = weldedCount <= 0xffff ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    printf("Mesh %-5s %5zu -> %5zu vertices, %5zu triangles, ACMR %.2f -> %.2f (%.2f after overdraw order), %d-bit indices\n",
+        name, vertexCount, weldedCount, mesh.indices.size() / 3, acmrBefore, acmrCache,
+        UComputeAcmr(mesh.indices, weldedCount), mesh.indexType == GL_UNSIGNED_SHORT ? 16 : 32);
+    return mesh;
+}
+
+
+// Upload a mesh's vertices and indices into new buffers, attached to the
+// bound VAO. Indices go out 16 bits wide when they fit.
+// @return index count
+GLsizei UUploadIndexedMesh(const IndexedMesh& mesh, GLuint& vbo, GLuint& ibo, GLenum& indexType)
+{
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo); // Activates the buffer
+    if (!mesh.packed.empty())
+        glBufferData(GL_ARRAY_BUFFER, mesh.packed.size() * sizeof(PackedVertex), mesh.packed.data(), GL_STATIC_DRAW);
+    else
+        glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(GLfloat), mesh.vertices.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    indexType = mesh.indexType;
+    if (indexType == GL_UNSIGNED_SHORT)
+    {
+        vector<GLushort> shortIndices(mesh.indices.begin(), mesh.indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(GLushort), shortIndices.data(), GL_STATIC_DRAW);
+    }
+    else
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(GLuint), mesh.indices.data(), GL_STATIC_DRAW);
+    return (GLsizei)mesh.indices.size();
+}
+
+
+// Add a welded mesh to the shared buffers' contents; its indices stay
+// relative to its own first vertex
+MeshRange UAppendMesh(IndexedMesh& merged, const IndexedMesh& part)
+{
+    MeshRange range;
+    range.firstIndex = (GLuint)merged.indices.size();
+    range.indexCount = (GLsizei)part.indices.size();
+    range.vertexCount = (GLsizei)(part.vertices.size() / 8);
+    range.baseVertex = (GLint)(merged.vertices.size() / 8);
+    range.decode = gCompactVertices ? UPackVertices(part, merged.packed) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    for (size_t v = 6; v < part.vertices.size() && merged.unitUvs; v += 8)
+        merged.unitUvs = part.vertices[v] >= 0.0f && part.vertices[v] <= 1.0f && part.vertices[v + 1] >= 0.0f && part.vertices[v + 1] <= 1.0f;
+    merged.vertices.insert(merged.vertices.end(), part.vertices.begin(), part.vertices.end());
+    merged.indices.insert(merged.indices.end(), part.indices.begin(), part.indices.end());
+    if (range.vertexCount > 0x10000)
+        merged.indexType = GL_UNSIGNED_INT;
+    return range;
+}
+
+
+// Append a welded 8-float mesh to packed in the compact format, and
+// return how its positions decode. Positions are stored relative to the
+// centre of the mesh's bounding cube, in units of half its side.
+glm::vec4 UPackVertices(const IndexedMesh& mesh, vector<PackedVertex>& packed)
+{
+    glm::vec3 low(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]), high = low;
+    for (size_t v = 0; v < mesh.vertices.size(); v += 8)
+    {
+        glm::vec3 position(mesh.vertices[v], mesh.vertices[v + 1], mesh.vertices[v + 2]);
+        low = glm::min(low, position);
+        high = glm::max(high, position);
+    }
+    glm::vec3 center = 0.5f * (low + high);
+    float half = 0.5f * max(high.x - low.x, max(high.y - low.y, high.z - low.z));
+    if (half <= 0.0f)
+        half = 1.0f;
+
+    for (size_t v = 0; v < mesh.vertices.size(); v += 8)
+    {
+        const GLfloat* source = &mesh.vertices[v];
+        PackedVertex vertex = {};
+        GLuint normal = 0;
+        for (int c = 0; c < 3; ++c)
+        {
+            float position = glm::clamp((source[c] - center[c]) / half, -1.0f, 1.0f);
+            vertex.position[c] = (GLshort)lround(position * 32767.0f);
+            normal |= ((GLuint)lround(glm::clamp(source[3 + c], -1.0f, 1.0f) * 511.0f) & 0x3ff) << (10 * c);
+        }
+        vertex.normal = normal;
+        for (int c = 0; c < 2; ++c)
+            vertex.uv[c] = (GLushort)lround(glm::clamp(source[6 + c], 0.0f, 1.0f) * 65535.0f);
+        packed.push_back(vertex);
+
+        // decode it the way GL does and keep the worst error
+        glm::vec3 position, decodedNormal;
+        for (int c = 0; c < 3; ++c)
+        {
+            position[c] = center[c] + half * max(vertex.position[c] / 32767.0f, -1.0f);
+            int bits = (int)(normal >> (10 * c)) & 0x3ff;
+            decodedNormal[c] = max((bits & 0x200 ? bits - 0x400 : bits) / 511.0f, -1.0f);
+        }
+        glm::vec3 original(source[3], source[4], source[5]);
+        gPositionError = max(gPositionError, glm::length(position - glm::vec3(source[0], source[1], source[2])));
+        if (glm::length(original) > 0.0f && glm::length(decodedNormal) > 0.0f)
+        {
+            float cosine = glm::clamp(glm::dot(glm::normalize(original), glm::normalize(decodedNormal)), -1.0f, 1.0f);
+            gNormalError = max(gNormalError, glm::degrees(acos(cosine)));
+        }
+        for (int c = 0; c < 2; ++c)
+            gUvError = max(gUvError, fabs(vertex.uv[c] / 65535.0f - source[6 + c]));
+    }
+    return glm::vec4(center, half);
+}
+
+
+// Go back to float vertices for meshes whose uvs tile or repeat: unorm16
+// uvs only cover [0,1], and the whole buffer shares one vertex format
+void UUnpackVertices(IndexedMesh& merged, const vector<MeshRange*>& ranges)
+{
+    cout << "Some uvs are outside [0,1]; keeping vertices as floats" << endl;
+    gCompactVertices = false;
+    merged.packed.clear();
+    for (MeshRange* range : ranges)
+        range->decode = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+
+// Model matrix term taking a mesh's stored positions to its own space:
+// a uniform scale and an offset, so normals keep their direction
+glm::mat4 UDecodeMatrix(const MeshRange& mesh)
+{
+    glm::mat4 decode(mesh.decode.w);
+    decode[3] = glm::vec4(glm::vec3(mesh.decode), 1.0f);
+    return decode;
+}
+
+
+// Attributes 0-2 (position, normal, uv) of the static geometry, read from
+// the bound GL_ARRAY_BUFFER in whichever format it was uploaded in
+void USetVertexFormat()
+{
+    if (gCompactVertices)
+    {
+        const GLint stride = sizeof(PackedVertex);
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, (void*)offsetof(PackedVertex, position));
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(PackedVertex, normal));
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(PackedVertex, uv));
+    }
+    else
+    {
+        const GLint stride = sizeof(float) * 8;
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * 3));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * 6));
+    }
+    for (GLuint attribute = 0; attribute < 3; ++attribute)
+        glEnableVertexAttribArray(attribute);
+}
+
+
+// Byte offset of a mesh's first index in the shared index buffer
+const void* UIndexOffset(const MeshRange& mesh)
+{
+    return (const void*)(mesh.firstIndex * (gMesh.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)));
+}
+
+
+// Append one vertex (position, normal, uv) to a shape
+inline void UPushVertex(vector<GLfloat>& verts, const glm::vec3& position, const glm::vec3& normal, float u, float v)
+{
+    const GLfloat vertex[] = { position.x, position.y, position.z, normal.x, normal.y, normal.z, u, v };
+    verts.insert(verts.end(), vertex, vertex + 8);
+}
+
+
+inline void UPushTriangle(vector<GLuint>& indices, GLuint a, GLuint b, GLuint c)
+{
+    indices.push_back(a);
+    indices.push_back(b);
+    indices.push_back(c);
+}
+
+
+// Flat disc at height y facing up (facing 1) or down (-1), uv mapped
+// straight down the axis
+void UAddDisc(vector<GLfloat>& verts, vector<GLuint>& indices, int sides, float radius, float y, float facing)
+{
+    const float TWO_PI = 2.0f * 3.1415926f;
+    GLuint centre = (GLuint)(verts.size() / 8);
+    glm::vec3 normal(0.0f, facing, 0.0f);
+    UPushVertex(verts, glm::vec3(0.0f, y, 0.0f), normal, 0.5f, 0.5f);
+    for (int i = 0; i < sides; ++i)
+    {
+        float theta = TWO_PI * i / sides;
+        UPushVertex(verts, glm::vec3(radius * cos(theta), y, radius * sin(theta)), normal, 0.5f + 0.5f * cos(theta), 0.5f + 0.5f * sin(theta));
+    }
+    for (int i = 0; i < sides; ++i)
+    {
+        GLuint a = centre + 1 + i, b = centre + 1 + (i + 1) % sides;
+        if (facing > 0.0f)
+            UPushTriangle(indices, centre, b, a);
+        else
+            UPushTriangle(indices, centre, a, b);
+    }
+}
+
+
+// Cylinder along y with capped ends. The side has a top and bottom
+// vertex per column; the seam column is doubled so u runs 0 to 1.
+void UAddCylinder(vector<GLfloat>& verts, vector<GLuint>& indices, int sides, float radius, float halfLen)
+{
+    const float TWO_PI = 2.0f * 3.1415926f;
+    GLuint base = (GLuint)(verts.size() / 8);
+    for (int i = 0; i <= sides; ++i)
+    {
+        float theta = TWO_PI * i / sides;
+        glm::vec3 normal(cos(theta), 0.0f, sin(theta));
+        UPushVertex(verts, glm::vec3(radius * normal.x, halfLen, radius * normal.z), normal, (float)i / sides, 1.0f);
+        UPushVertex(verts, glm::vec3(radius * normal.x, -halfLen, radius * normal.z), normal, (float)i / sides, 0.0f);
+    }
+    for (int i = 0; i < sides; ++i)
+    {
+        GLuint top = base + 2 * i, bottom = top + 1;
+        UPushTriangle(indices, bottom, top, top + 2);
+        UPushTriangle(indices, bottom, top + 2, bottom + 2);
+    }
+    UAddDisc(verts, indices, sides, radius, halfLen, 1.0f);
+    UAddDisc(verts, indices, sides, radius, -halfLen, -1.0f);
+}
+
+
+// Cone along y, apex at +halfLen, with a capped base. Each column has
+// its own apex vertex so the side normals stay smooth around the axis.
+void UAddCone(vector<GLfloat>& verts, vector<GLuint>& indices, int sides, float radius, float halfLen)
+{
+    const float TWO_PI = 2.0f * 3.1415926f;
+    const float slope = radius / (2.0f * halfLen);
+    GLuint base = (GLuint)(verts.size() / 8);
+    for (int i = 0; i <= sides; ++i)
+    {
+        float theta = TWO_PI * i / sides;
+        glm::vec3 normal = glm::normalize(glm::vec3(cos(theta), slope, sin(theta)));
+        UPushVertex(verts, glm::vec3(0.0f, halfLen, 0.0f), normal, (float)i / sides, 1.0f);
+        UPushVertex(verts, glm::vec3(radius * cos(theta), -halfLen, radius * sin(theta)), normal, (float)i / sides, 0.0f);
+    }
+    for (int i = 0; i < sides; ++i)
+    {
+        GLuint apex = base + 2 * i, bottom = apex + 1;
+        UPushTriangle(indices, bottom, apex, bottom + 2);
+    }
+    UAddDisc(verts, indices, sides, radius, -halfLen, -1.0f);
+}
+
+
+// UV sphere about the origin, with half as many stacks as sides
+void UAddSphere(vector<GLfloat>& verts, vector<GLuint>& indices, int sides, float radius)
+{
+    const float PI = 3.1415926f;
+    const int stacks = max(sides / 2, 2);
+    GLuint base = (GLuint)(verts.size() / 8);
+    for (int j = 0; j <= stacks; ++j)
+    {
+        float phi = PI * j / stacks;
+        for (int i = 0; i <= sides; ++i)
+        {
+            float theta = 2.0f * PI * i / sides;
+            glm::vec3 normal(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+            UPushVertex(verts, radius * normal, normal, (float)i / sides, 1.0f - (float)j / stacks);
+        }
+    }
+    // the triangles that would meet in a single point at the poles are left out
+    for (int j = 0; j < stacks; ++j)
+    {
+        for (int i = 0; i < sides; ++i)
+        {
+            GLuint top = base + j * (sides + 1) + i, bottom = top + sides + 1;
+            if (j > 0)
+                UPushTriangle(indices, bottom, top, top + 1);
+            if (j < stacks - 1)
+                UPushTriangle(indices, bottom, top + 1, bottom + 1);
+        }
+    }
+}
+
+
+// Generate every shape at every level of detail, sized like the soda
+// can, and add them to the shared buffers as one block
+void UCreateShapes(GLMesh& mesh, IndexedMesh& merged)
+{
+    const float radius = 0.15f, halfLen = 0.25f;
+    IndexedMesh shapes;
+    for (int shape = 0; shape < SHAPE_COUNT; ++shape)
+    {
+        for (int lod = 0; lod < LOD_COUNT; ++lod)
+        {
+            MeshRange& range = mesh.shapeLods[shape][lod];
+            range.firstIndex = (GLuint)shapes.indices.size();
+            size_t firstVertex = shapes.vertices.size() / 8;
+            if (shape == SHAPE_CYLINDER)
+                UAddCylinder(shapes.vertices, shapes.indices, LOD_SIDES[lod], radius, halfLen);
+            else if (shape == SHAPE_CONE)
+                UAddCone(shapes.vertices, shapes.indices, LOD_SIDES[lod], radius, halfLen);
+            else
+                UAddSphere(shapes.vertices, shapes.indices, LOD_SIDES[lod], halfLen);
+            range.indexCount = (GLsizei)(shapes.indices.size() - range.firstIndex);
+            range.vertexCount = (GLsizei)(shapes.vertices.size() / 8 - firstVertex);
+        }
+    }
+    mesh.shapeRadius[SHAPE_CYLINDER] = mesh.shapeRadius[SHAPE_CONE] = sqrt(radius * radius + halfLen * halfLen);
+    mesh.shapeRadius[SHAPE_SPHERE] = halfLen;
+
+    // into the shared buffers, every level drawn from the block's base vertex
+    MeshRange block = UAppendMesh(merged, shapes);
+    for (int shape = 0; shape < SHAPE_COUNT; ++shape)
+    {
+        for (int lod = 0; lod < LOD_COUNT; ++lod)
+        {
+            mesh.shapeLods[shape][lod].firstIndex += block.firstIndex;
+            mesh.shapeLods[shape][lod].baseVertex = block.baseVertex;
+            mesh.shapeLods[shape][lod].decode = block.decode;
+        }
+    }
+
+    printf("Shapes: cylinder, cone and sphere at %d/%d/%d/%d sides, %zu vertices and %zu triangles\n",
+        LOD_SIDES[0], LOD_SIDES[1], LOD_SIDES[2], LOD_SIDES[3], shapes.vertices.size() / 8, shapes.indices.size() / 3);
+}
+
+
+// Level of detail for a shape from how tall it is on screen: its
+// bounding sphere's projected diameter in pixels
+int USelectLod(int shape, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+{
+    if (gForcedLod >= 0)
+        return gForcedLod;
+    float scale = max(glm::length(glm::vec3(model[0])), max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    float distance = max(-(view * model[3]).z, 0.1f);
+    float pixels = gMesh.shapeRadius[shape] * scale * projection[1][1] * WINDOW_HEIGHT / distance;
+    int lod = 0;
+    while (lod < LOD_COUNT - 1 && pixels < LOD_MIN_PIXELS[lod])
+        ++lod;
+    return lod;
+}
+
+
+// Bounding sphere of a welded 8-float mesh: centre of its box, radius to
+// the farthest vertex from there
+glm::vec4 UComputeBounds(const IndexedMesh& mesh)
+{
+    glm::vec3 low(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]), high = low;
+    for (size_t v = 0; v < mesh.vertices.size(); v += 8)
+    {
+        glm::vec3 position(mesh.vertices[v], mesh.vertices[v + 1], mesh.vertices[v + 2]);
+        low = glm::min(low, position);
+        high = glm::max(high, position);
+    }
+    glm::vec3 center = 0.5f * (low + high);
+    float radius = 0.0f;
+    for (size_t v = 0; v < mesh.vertices.size(); v += 8)
+        radius = max(radius, glm::length(glm::vec3(mesh.vertices[v], mesh.vertices[v + 1], mesh.vertices[v + 2]) - center));
+    return glm::vec4(center, radius);
+}
+
+
+// Implements the UCreateMesh function
+void UCreateMesh(GLMesh& mesh)
+{
+
+
+    // Position and Color data
+    GLfloat toyVerts[] = {
+        //Positions                Normals                Textures
+
+       -0.5f, -0.5f, -0.5f,     0.0f,  0.0f, -1.0f,      0.0f, 0.0f,
+        0.5f, -0.5f, -0.5f,     0.0f,  0.0f, -1.0f,      1.0f, 0.0f,
+        0.0f,  0.5f,  0.0f,     0.0f,  0.0f, -1.0f,      0.5f, 1.0f,
+
+       -0.5f, -0.5f,  0.5f,     0.0f,  0.0f,  1.0f,      0.0f, 0.0f,
+        0.5f, -0.5f,  0.5f,     0.0f,  0.0f,  1.0f,      1.0f, 0.0f,
+        0.0f,  0.5f,  0.0f,     0.0f,  0.0f,  1.0f,      0.5f, 1.0f,
+
+       -0.5f, -0.5f, -0.5f,    -1.0f,  0.0f,  0.0f,      0.0f, 1.0f,
+       -0.5f, -0.5f,  0.5f,    -1.0f,  0.0f,  0.0f,      0.0f, 0.0f,
+        0.0f,  0.5f,  0.0f,    -1.0f,  0.0f,  0.0f,      0.5f, 1.0f,
+
+        0.5f, -0.5f, -0.5f,     1.0f,  0.0f,  0.0f,      0.0f, 1.0f,
+        0.5f, -0.5f,  0.5f,     1.0f,  0.0f,  0.0f,      0.0f, 0.0f,
+        0.0f,  0.5f,  0.0f,     1.0f,  0.0f,  0.0f,      0.5f, 1.0f,
+
+        0.5f, -0.5f, -0.5f,     0.0f, -1.0f,  0.0f,      1.0f, 1.0f,
+        0.5f, -0.5f,  0.5f,     0.0f, -1.0f,  0.0f,      1.0f, 0.0f,
+        0.0f,  0.5f,  0.0f,     0.0f, -1.0f,  0.0f,      0.5f, 1.0f,
+
+       -0.5f, -0.5f,  0.5f,     0.0f,  1.0f,  0.0f,      0.0f, 0.0f,
+       -0.5f, -0.5f, -0.5f,     0.0f,  1.0f,  0.0f,      0.0f, 1.0f,
+        0.0f,  0.5f,  0.0f,     0.0f,  1.0f,  0.0f,      0.5f, 1.0f
+
+
+    };
+    GLfloat planeVerts[] = {
+        //Positions                      Normals                Textures
+          2.0f, -0.2f,  1.0f,        0.0f,  0.0f, 1.0f,        1.0f, 0.0f,
+         -2.0f, -0.2f, -1.0f,        0.0f,  0.0f, 1.0f,        0.0f, 0.0f,
+          2.0f, -0.2f, -1.0f,        0.0f,  0.0f, 1.0f,        0.0f, 1.0f,
+
+          2.0f, -0.2f,  1.0f,        0.0f,  0.0f, 1.0f,        1.0f, 0.0f,
+         -2.0f, -0.2f,  1.0f,        0.0f,  0.0f, 1.0f,        1.0f, 1.0f,
+         -2.0f, -0.2f, -1.0f,        0.0f,  0.0f, 1.0f,        0.0f, 0.0f,
+    };
+
+    GLfloat cubeVerts[] = {
+        //Positions                      Normals                Textures
+
+         -0.5f, -0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        0.0f, 0.0f,
+          0.5f, -0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        1.0f, 0.0f,
+          0.5f,  0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        1.0f, 1.0f,
+          0.5f,  0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        1.0f, 1.0f,
+         -0.5f,  0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        0.0f, 1.0f,
+         -0.5f, -0.5f, -0.5f,       0.0f,  0.0f, -1.0f,        0.0f, 0.0f,
+
+
+         -0.5f, -0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        0.0f, 0.0f,
+          0.5f, -0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        1.0f, 0.0f,
+          0.5f,  0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        1.0f, 1.0f,
+          0.5f,  0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        1.0f, 1.0f,
+         -0.5f,  0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        0.0f, 1.0f,
+         -0.5f, -0.5f,  0.5f,       0.0f,  0.0f,  1.0f,        0.0f, 0.0f,
+
+
+         -0.5f,  0.5f,  0.5f,      -1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
+         -0.5f,  0.5f, -0.5f,      -1.0f,  0.0f,  0.0f,        1.0f, 1.0f,
+         -0.5f, -0.5f, -0.5f,      -1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
+         -0.5f, -0.5f, -0.5f,      -1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
+         -0.5f, -0.5f,  0.5f,      -1.0f,  0.0f,  0.0f,        0.0f, 0.0f,
+         -0.5f,  0.5f,  0.5f,      -1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
+
+
+          0.5f,  0.5f,  0.5f,       1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
+          0.5f,  0.5f, -0.5f,       1.0f,  0.0f,  0.0f,        1.0f, 1.0f,
+          0.5f, -0.5f, -0.5f,       1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
+          0.5f, -0.5f, -0.5f,       1.0f,  0.0f,  0.0f,        0.0f, 1.0f,
+          0.5f, -0.5f,  0.5f,       1.0f,  0.0f,  0.0f,        0.0f, 0.0f,
+          0.5f,  0.5f,  0.5f,       1.0f,  0.0f,  0.0f,        1.0f, 0.0f,
+
+
+         -0.5f, -0.5f, -0.5f,       0.0f, -1.0f,  0.0f,        0.0f, 1.0f,
+          0.5f, -0.5f, -0.5f,       0.0f, -1.0f,  0.0f,        1.0f, 1.0f,
+          0.5f, -0.5f,  0.5f,       0.0f, -1.0f,  0.0f,        1.0f, 0.0f,
+          0.5f, -0.5f,  0.5f,       0.0f, -1.0f,  0.0f,        1.0f, 0.0f,
+         -0.5f, -0.5f,  0.5f,       0.0f, -1.0f,  0.0f,        0.0f, 0.0f,
+         -0.5f, -0.5f, -0.5f,       0.0f, -1.0f,  0.0f,        0.0f, 1.0f,
+
+
+         -0.5f,  0.5f, -0.5f,       0.0f,  1.0f,  0.0f,        0.0f, 1.0f,
+          0.5f,  0.5f, -0.5f,       0.0f,  1.0f,  0.0f,        1.0f, 1.0f,
+          0.5f,  0.5f,  0.5f,       0.0f,  1.0f,  0.0f,        1.0f, 0.0f,
+          0.5f,  0.5f,  0.5f,       0.0f,  1.0f,  0.0f,        1.0f, 0.0f,
+         -0.5f,  0.5f,  0.5f,       0.0f,  1.0f,  0.0f,        0.0f, 0.0f,
+         -0.5f,  0.5f, -0.5f,       0.0f,  1.0f,  0.0f,        0.0f, 1.0f
+    };
+
+    const GLuint floatsPerVertex = 3;
+    const GLuint floatsPerNormal = 3;
+    const GLuint floatsPerUV = 2;
+
+    // Weld shared corners and order the triangles for the vertex cache
+    IndexedMesh toy = UBuildIndexedMesh("toy", toyVerts, sizeof(toyVerts) / (sizeof(toyVerts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV)),
+        floatsPerVertex + floatsPerNormal + floatsPerUV);
+    IndexedMesh plane = UBuildIndexedMesh("plane", planeVerts, sizeof(planeVerts) / (sizeof(planeVerts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV)),
+        floatsPerVertex + floatsPerNormal + floatsPerUV);
+    IndexedMesh cube = UBuildIndexedMesh("cube", cubeVerts, sizeof(cubeVerts) / (sizeof(cubeVerts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV)),
+        floatsPerVertex + floatsPerNormal + floatsPerUV);
+    mesh.toyBounds = UComputeBounds(toy);
+    mesh.planeBounds = UComputeBounds(plane);
+    mesh.cubeBounds = UComputeBounds(cube);
+
+    // Pack every mesh into one vertex and one index buffer; each keeps its
+    // own index numbering and is drawn from its base vertex. A scene file's
+    // meshes come first, in the file's vertex format and index type.
+    const SceneFileHeader* scene = gSceneFile.header;
+    IndexedMesh merged;
+    merged.indexType = scene != nullptr ? scene->indexType : GL_UNSIGNED_SHORT;
+    if (scene != nullptr && gCompactVertices != (scene->packedVertices != 0))
+    {
+        cout << "The scene file's vertices are " << (scene->packedVertices ? "compressed" : "floats") << "; using its format" << endl;
+        gCompactVertices = scene->packedVertices != 0;
+    }
+    size_t fileVertices = 0, fileIndices = 0;
+    mesh.toy = UAppendMesh(merged, toy);
+    mesh.plane = UAppendMesh(merged, plane);
+    UCreateShapes(mesh, merged);    // the cylinder, along with the other parametric shapes
+    mesh.cube = UAppendMesh(merged, cube);
+
+    vector<MeshRange*> builtIn = { &mesh.toy, &mesh.plane, &mesh.cube };
+    for (int shape = 0; shape < SHAPE_COUNT; ++shape)
+        for (int lod = 0; lod < LOD_COUNT; ++lod)
+            builtIn.push_back(&mesh.shapeLods[shape][lod]);
+    if (gCompactVertices && !merged.unitUvs && scene == nullptr)
+        UUnpackVertices(merged, builtIn);
+
+    glGenVertexArrays(1, &mesh.vao);
+    glBindVertexArray(mesh.vao);
+
+    // Create 2 buffers: first one for the vertex data; second one for the indices
+    if (scene != nullptr)
+    {
+        fileVertices = scene->vertexBytes / (gCompactVertices ? sizeof(PackedVertex) : sizeof(GLfloat) * 8);
+        fileIndices = scene->indexBytes / (scene->indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+        for (MeshRange* range : builtIn)
+        {
+            range->baseVertex += (GLint)fileVertices;
+            range->firstIndex += (GLuint)fileIndices;
+        }
+        UUploadSceneGeometry(gSceneFile, merged, mesh);
+    }
+    else
+        UUploadIndexedMesh(merged, mesh.vbo, mesh.ibo, mesh.indexType);
+
+    // Create Vertex Attribute Pointers
+    USetVertexFormat();
+
+    size_t vertexCount = fileVertices + merged.vertices.size() / 8;
+    printf("Static geometry: %zu vertices and %zu triangles in one buffer, %d-bit indices\n",
+        vertexCount, (fileIndices + merged.indices.size()) / 3, mesh.indexType == GL_UNSIGNED_SHORT ? 16 : 32);
+    if (gCompactVertices)
+        printf("Vertex compression: %zu bytes of vertices against %zu as floats (%.2fx smaller); largest error %g in position, "
+            "%.3f degrees in normals, %g in uv\n", vertexCount * sizeof(PackedVertex), vertexCount * 8 * sizeof(GLfloat),
+            (8.0 * sizeof(GLfloat)) / sizeof(PackedVertex), gPositionError, gNormalError, gUvError);
+}
+
+
+void UDestroyMesh(GLMesh& mesh)
+{
+    glDeleteVertexArrays(1, &mesh.vao);
+    glDeleteBuffers(1, &mesh.vbo);
+    glDeleteBuffers(1, &mesh.ibo);
+}
+
+
+// Map a scene file and check that its blocks, ranges and indices fit
+// inside it; nothing in it is parsed or copied, only the indices read
+bool UOpenSceneFile(const string& path, SceneFile& scene)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (!UMapFile(path, scene.mapped))
+        return false;
+    const unsigned char* data = scene.mapped.data;
+    uint64_t size = scene.mapped.size;
+    const SceneFileHeader* header = (const SceneFileHeader*)data;
+    auto fits = [&](uint64_t offset, uint64_t bytes) { return offset % 16 == 0 && offset <= size && bytes <= size - offset; };
+    bool valid = size >= sizeof(SceneFileHeader) && memcmp(header->magic, "PYRSCN01", 8) == 0
+        && (header->indexType == GL_UNSIGNED_SHORT || header->indexType == GL_UNSIGNED_INT)
+        && fits(header->vertexOffset, header->vertexBytes) && fits(header->indexOffset, header->indexBytes)
+        && fits(header->meshOffset, (uint64_t)header->meshCount * sizeof(SceneFileMesh))
+        && fits(header->objectOffset, (uint64_t)header->objectCount * sizeof(SceneFileObject))
+        && fits(header->textureOffset, (uint64_t)header->textureCount * sizeof(SceneFileTexture));
+    if (!valid)
+    {
+        UCloseSceneFile(scene);
+        return false;
+    }
+    scene.header = header;
+    scene.meshes = (const SceneFileMesh*)(data + header->meshOffset);
+    scene.objects = (const SceneFileObject*)(data + header->objectOffset);
+    scene.textures = (const SceneFileTexture*)(data + header->textureOffset);
+
+    // ranges and references must stay inside the file's buffers and tables,
+    // and every index inside its mesh's vertices; the counts are signed,
+    // so the sums are too. The built-in meshes go right after the blocks,
+    // so each must end on a whole vertex and a whole index.
+    size_t vertexSize = header->packedVertices ? sizeof(PackedVertex) : sizeof(GLfloat) * 8;
+    size_t indexSize = header->indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    valid = header->vertexBytes % vertexSize == 0 && header->indexBytes % indexSize == 0;
+    int64_t vertexCount = (int64_t)(header->vertexBytes / vertexSize);
+    int64_t indexCount = (int64_t)(header->indexBytes / indexSize);
+    auto indicesBelow = [](const auto* indices, int64_t count, int64_t limit)
+    {
+        for (int64_t i = 0; i < count; ++i)
+            if (indices[i] >= limit)
+                return false;
+        return true;
+    };
+    for (uint32_t i = 0; i < header->meshCount && valid; ++i)
+    {
+        const MeshRange& range = scene.meshes[i].range;
+        valid = range.baseVertex >= 0 && range.vertexCount >= 0 && range.indexCount >= 0
+            && (int64_t)range.baseVertex + range.vertexCount <= vertexCount
+            && (int64_t)range.firstIndex + range.indexCount <= indexCount;
+        if (valid && header->indexType == GL_UNSIGNED_SHORT)
+            valid = indicesBelow((const GLushort*)(data + header->indexOffset) + range.firstIndex, range.indexCount, range.vertexCount);
+        else if (valid)
+            valid = indicesBelow((const GLuint*)(data + header->indexOffset) + range.firstIndex, range.indexCount, range.vertexCount);
+    }
+    for (uint32_t i = 0; i < header->objectCount && valid; ++i)
+        valid = scene.objects[i].mesh < header->meshCount && scene.objects[i].texture >= -1
+            && scene.objects[i].texture < (int32_t)header->textureCount;
+    for (uint32_t i = 0; i < header->textureCount && valid; ++i)
+        valid = memchr(scene.textures[i].path, 0, sizeof(scene.textures[i].path)) != nullptr;
+    if (!valid)
+    {
+        UCloseSceneFile(scene);
+        return false;
+    }
+    scene.loadSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+
+void UCloseSceneFile(SceneFile& scene)
+{
+    UUnmapFile(scene.mapped);
+    scene.header = nullptr;
+    scene.meshes = nullptr;
+    scene.objects = nullptr;
+    scene.textures = nullptr;
+}
+
+
+// Fill the shared buffers with the scene file's blocks, straight from the
+// mapping, followed by the built-in meshes already offset to sit after them
+void UUploadSceneGeometry(SceneFile& scene, const IndexedMesh& builtIn, GLMesh& mesh)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    const SceneFileHeader& header = *scene.header;
+    const unsigned char* data = scene.mapped.data;
+
+    size_t builtInBytes = builtIn.packed.empty() ? builtIn.vertices.size() * sizeof(GLfloat) : builtIn.packed.size() * sizeof(PackedVertex);
+    const void* builtInVertices = builtIn.packed.empty() ? (const void*)builtIn.vertices.data() : (const void*)builtIn.packed.data();
+    glGenBuffers(1, &mesh.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    glBufferData(GL_ARRAY_BUFFER, header.vertexBytes + builtInBytes, NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, header.vertexBytes, data + header.vertexOffset);
+    glBufferSubData(GL_ARRAY_BUFFER, header.vertexBytes, builtInBytes, builtInVertices);
+
+    // the built-in meshes may need 32-bit indices where the file has 16;
+    // its indices are then widened rather than uploaded as they are
+    mesh.indexType = builtIn.indexType;
+    size_t fileIndexCount = header.indexBytes / (header.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+    const void* fileIndices = data + header.indexOffset;
+    vector<GLuint> wideIndices;
+    if (mesh.indexType != header.indexType)
+    {
+        const GLushort* narrow = (const GLushort*)fileIndices;
+        wideIndices.assign(narrow, narrow + fileIndexCount);
+        fileIndices = wideIndices.data();
+    }
+    vector<GLushort> shortIndices;
+    size_t indexSize = sizeof(GLuint);
+    const void* builtInIndices = builtIn.indices.data();
+    if (mesh.indexType == GL_UNSIGNED_SHORT)
+    {
+        shortIndices.assign(builtIn.indices.begin(), builtIn.indices.end());
+        indexSize = sizeof(GLushort);
+        builtInIndices = shortIndices.data();
+    }
+    glGenBuffers(1, &mesh.ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (fileIndexCount + builtIn.indices.size()) * indexSize, NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, fileIndexCount * indexSize, fileIndices);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, fileIndexCount * indexSize, builtIn.indices.size() * indexSize, builtInIndices);
+    scene.loadSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    uint64_t triangles = fileIndexCount / 3;
+    cout << "Scene " << gSceneFilePath << ": " << header.meshCount << " meshes, " << header.objectCount << " objects, "
+         << triangles << " triangles, " << (header.vertexBytes + header.indexBytes) / 1024 << " KB of buffers mapped and uploaded in "
+         << 1000.0 * scene.loadSeconds << " ms" << endl;
+}
+
+
+// Read the material library of an OBJ: each material's diffuse map
+void UReadObjMaterials(const filesystem::path& path, unordered_map<string, string>& diffuseMaps)
+{
+    ifstream file(path);
+    string line, material;
+    while (getline(file, line))
+    {
+        istringstream fields(line);
+        string keyword;
+        fields >> keyword;
+        if (keyword == "newmtl")
+            fields >> material;
+        else if (keyword == "map_Kd")
+        {
+            string map;
+            getline(fields >> ws, map);
+            while (!map.empty() && isspace((unsigned char)map.back()))
+                map.pop_back();
+            diffuseMaps[material] = (path.parent_path() / map).string();
+        }
+    }
+}
+
+
+// Convert a Wavefront OBJ into a scene file: each group (o, g, or a
+// change of material) becomes a mesh, welded and ordered like the built-in
+// ones, drawn by one object at the origin with its material's diffuse map
+int UConvertObj(const string& objPath, const string& outPath)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ifstream file(objPath);
+    if (!file)
+    {
+        cout << "Failed to open " << objPath << endl;
+        return EXIT_FAILURE;
+    }
+
+    // one group's triangles, unwelded: 8 floats per corner
+    struct ObjGroup
+    {
+        string name, material;
+        vector<GLfloat> corners;
+    };
+    vector<glm::vec3> positions, normals;
+    vector<glm::vec2> uvs;
+    vector<ObjGroup> groups(1);
+    unordered_map<string, string> diffuseMaps;
+    string line;
+    while (getline(file, line))
+    {
+        const char* cursor = line.c_str();
+        while (*cursor == ' ' || *cursor == '\t')
+            ++cursor;
+        char* end;
+        if (cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == 't' || cursor[1] == 'n'))
+        {
+            char kind = cursor[1];
+            cursor += kind == ' ' ? 1 : 2;
+            float value[3] = {};
+            for (int c = 0; c < (kind == 't' ? 2 : 3); ++c, cursor = end)
+                value[c] = strtof(cursor, &end);
+            if (kind == ' ')
+                positions.push_back(glm::vec3(value[0], value[1], value[2]));
+            else if (kind == 't')
+                uvs.push_back(glm::vec2(value[0], value[1]));
+            else
+                normals.push_back(glm::vec3(value[0], value[1], value[2]));
+        }
+        else if (cursor[0] == 'f' && cursor[1] == ' ')
+        {
+            // a polygon's corners as position/uv/normal references, 1-based
+            // or, when negative, counted back from the last one read
+            int corner[64][3];
+            int count = 0;
+            for (cursor += 2; *cursor != 0 && count < 64;)
+            {
+                long index[3] = { 0, 0, 0 };
+                for (int part = 0; part < 3; ++part)
+                {
+                    if (*cursor != '/')
+                    {
+                        index[part] = strtol(cursor, &end, 10);
+                        if (end == cursor)
+                            break;
+                        cursor = end;
+                    }
+                    if (*cursor != '/')
+                        break;
+                    ++cursor;
+                }
+                const size_t sizes[3] = { positions.size(), uvs.size(), normals.size() };
+                for (int part = 0; part < 3; ++part)
+                    corner[count][part] = index[part] < 0 ? (int)(sizes[part] + index[part]) : (int)index[part] - 1;
+                if (index[0] != 0)
+                    ++count;
+                while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')
+                    ++cursor;
+                if (index[0] == 0)
+                    break;
+            }
+            for (int i = 0; i < count; ++i)
+            {
+                if (corner[i][0] < 0 || corner[i][0] >= (int)positions.size())
+                {
+                    cout << "Bad face in " << objPath << ": " << line << endl;
+                    return EXIT_FAILURE;
+                }
+            }
+
+            // fan out the polygon; corners with no normal take the face's
+            ObjGroup& group = groups.back();
+            for (int i = 1; i + 1 < count; ++i)
+            {
+                const int* triangle[3] = { corner[0], corner[i], corner[i + 1] };
+                glm::vec3 faceNormal = glm::cross(positions[triangle[1][0]] - positions[triangle[0][0]],
+                    positions[triangle[2][0]] - positions[triangle[0][0]]);
+                faceNormal = glm::length(faceNormal) > 0.0f ? glm::normalize(faceNormal) : glm::vec3(0.0f, 1.0f, 0.0f);
+                for (const int* c : triangle)
+                {
+                    glm::vec3 normal = c[2] >= 0 && c[2] < (int)normals.size() ? normals[c[2]] : faceNormal;
+                    glm::vec2 uv = c[1] >= 0 && c[1] < (int)uvs.size() ? uvs[c[1]] : glm::vec2(0.0f);
+                    const glm::vec3& position = positions[c[0]];
+                    const GLfloat vertex[] = { position.x, position.y, position.z, normal.x, normal.y, normal.z, uv.x, uv.y };
+                    group.corners.insert(group.corners.end(), vertex, vertex + 8);
+                }
+            }
+        }
+        else
+        {
+            istringstream fields(line);
+            string keyword, value;
+            fields >> keyword >> value;
+            if (keyword == "mtllib")
+                UReadObjMaterials(filesystem::path(objPath).parent_path() / value, diffuseMaps);
+            else if (keyword == "o" || keyword == "g" || keyword == "usemtl")
+            {
+                if (!groups.back().corners.empty())
+                {
+                    groups.push_back(ObjGroup());
+                    groups.back().name = groups[groups.size() - 2].name;
+                    groups.back().material = groups[groups.size() - 2].material;
+                }
+                (keyword == "usemtl" ? groups.back().material : groups.back().name) = value;
+            }
+        }
+    }
+    double parseSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // weld and order every group, then lay them out as the buffers will be
+    IndexedMesh merged;
+    merged.indexType = GL_UNSIGNED_SHORT;
+    vector<SceneFileMesh> meshes;
+    vector<SceneFileObject> objects;
+    vector<SceneFileTexture> textures;
+    filesystem::path outDirectory = filesystem::absolute(outPath).parent_path();
+    for (const ObjGroup& group : groups)
+    {
+        if (group.corners.empty())
+            continue;
+        IndexedMesh part = UBuildIndexedMesh(group.name.empty() ? "obj" : group.name.c_str(), group.corners.data(), group.corners.size() / 8, 8);
+        SceneFileMesh mesh;
+        mesh.range = UAppendMesh(merged, part);
+        mesh.bounds = UComputeBounds(part);
+
+        SceneFileObject object = { (uint32_t)meshes.size(), -1, { 0.0f, 0.0f, 0.0f }, 1.0f };
+        unordered_map<string, string>::const_iterator map = diffuseMaps.find(group.material);
+        if (map != diffuseMaps.end())
+        {
+            SceneFileTexture texture = {};
+            string relative = filesystem::absolute(map->second).lexically_relative(outDirectory).generic_string();
+            strncpy(texture.path, relative.c_str(), sizeof(texture.path) - 1);
+            size_t t = 0;
+            while (t < textures.size() && strcmp(textures[t].path, texture.path) != 0)
+                ++t;
+            if (t == textures.size())
+                textures.push_back(texture);
+            object.texture = (int32_t)t;
+        }
+        meshes.push_back(mesh);
+        objects.push_back(object);
+    }
+    if (meshes.empty())
+    {
+        cout << "No faces in " << objPath << endl;
+        return EXIT_FAILURE;
+    }
+    if (gCompactVertices && !merged.unitUvs)
+    {
+        vector<MeshRange*> ranges;
+        for (SceneFileMesh& mesh : meshes)
+            ranges.push_back(&mesh.range);
+        UUnpackVertices(merged, ranges);
+    }
+
+    // the blocks in order, each on a 16-byte boundary
+    vector<GLushort> shortIndices;
+    if (merged.indexType == GL_UNSIGNED_SHORT)
+        shortIndices.assign(merged.indices.begin(), merged.indices.end());
+    SceneFileHeader header = {};
+    memcpy(header.magic, "PYRSCN01", 8);
+    header.packedVertices = gCompactVertices ? 1 : 0;
+    header.indexType = merged.indexType;
+    header.meshCount = (uint32_t)meshes.size();
+    header.objectCount = (uint32_t)objects.size();
+    header.textureCount = (uint32_t)textures.size();
+    header.vertexBytes = gCompactVertices ? merged.packed.size() * sizeof(PackedVertex) : merged.vertices.size() * sizeof(GLfloat);
+    header.indexBytes = merged.indices.size() * (merged.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+    auto align = [](uint64_t offset) { return (offset + 15) & ~(uint64_t)15; };
+    header.vertexOffset = align(sizeof(SceneFileHeader));
+    header.indexOffset = align(header.vertexOffset + header.vertexBytes);
+    header.meshOffset = align(header.indexOffset + header.indexBytes);
+    header.objectOffset = align(header.meshOffset + meshes.size() * sizeof(SceneFileMesh));
+    header.textureOffset = align(header.objectOffset + objects.size() * sizeof(SceneFileObject));
+
+    const void* vertexData = gCompactVertices ? (const void*)merged.packed.data() : (const void*)merged.vertices.data();
+    const void* indexData = merged.indexType == GL_UNSIGNED_SHORT ? (const void*)shortIndices.data() : (const void*)merged.indices.data();
+    const pair<uint64_t, pair<const void*, uint64_t>> blocks[] = {
+        { 0, { &header, sizeof(header) } },
+        { header.vertexOffset, { vertexData, header.vertexBytes } },
+        { header.indexOffset, { indexData, header.indexBytes } },
+        { header.meshOffset, { meshes.data(), meshes.size() * sizeof(SceneFileMesh) } },
+        { header.objectOffset, { objects.data(), objects.size() * sizeof(SceneFileObject) } },
+        { header.textureOffset, { textures.data(), textures.size() * sizeof(SceneFileTexture) } },
+    };
+    string tempPath = outPath + ".tmp";
+    {
+        ofstream out(tempPath, ios::binary | ios::trunc);
+        const char zeros[16] = {};
+        for (const auto& block : blocks)
+        {
+            out.write(zeros, block.first - (uint64_t)out.tellp());
+            out.write((const char*)block.second.first, block.second.second);
+        }
+        if (!out)
+        {
+            cout << "Failed to write " << outPath << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    error_code error;
+    filesystem::rename(tempPath, outPath, error);
+    if (error)
+    {
+        cout << "Failed to write " << outPath << endl;
+        return EXIT_FAILURE;
+    }
+
+    cout << "Converted " << objPath << " to " << outPath << ": " << meshes.size() << " meshes, " << merged.indices.size() / 3
+         << " triangles, " << merged.vertices.size() / 8 << " vertices, " << textures.size() << " textures; parsed in "
+         << 1000.0 * parseSeconds << " ms, done in " << 1000.0 * chrono::duration<double>(chrono::steady_clock::now() - start).count()
+         << " ms" << endl;
+    if (gCompactVertices)
+        printf("Vertex compression: largest error %g in position, %.3f degrees in normals, %g in uv\n",
+            gPositionError, gNormalError, gUvError);
+    return EXIT_SUCCESS;
+}
+
+
+// Map a whole file read-only; false if it cannot be opened
+bool UMapFile(const string& path, MappedFile& mapped)
+{
+#ifdef _WIN32
+    mapped.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapped.file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(mapped.file, &size);
+    mapped.size = (size_t)size.QuadPart;
+    mapped.mapping = mapped.size > 0 ? CreateFileMappingA(mapped.file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    if (mapped.mapping != NULL)
+        mapped.data = (const unsigned char*)MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat info;
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+    {
+        mapped.size = (size_t)info.st_size;
+        void* data = mmap(NULL, mapped.size, PROT_READ, MAP_PRIVATE, file, 0);
+        mapped.data = data != MAP_FAILED ? (const unsigned char*)data : nullptr;
+    }
+    close(file);    // the mapping stays valid
+#endif
+    if (mapped.data == nullptr)
+    {
+        UUnmapFile(mapped);
+        return false;
+    }
+    return true;
+}
+
+
+void UUnmapFile(MappedFile& mapped)
+{
+#ifdef _WIN32
+    if (mapped.data != nullptr)
+        UnmapViewOfFile(mapped.data);
+    if (mapped.mapping != NULL)
+        CloseHandle(mapped.mapping);
+    if (mapped.file != INVALID_HANDLE_VALUE)
+        CloseHandle(mapped.file);
+    mapped.file = INVALID_HANDLE_VALUE;
+    mapped.mapping = NULL;
+#else
+    if (mapped.data != nullptr)
+        munmap((void*)mapped.data, mapped.size);
+#endif
+    mapped.data = nullptr;
+    mapped.size = 0;
+}
+
+
+// Bytes of every mip level of a width x height image, down to 1 x 1
+size_t UMipChainSize(int width, int height, int channels, int levels)
+{
+    size_t size = 0;
+    for (int level = 0; level < levels; ++level)
+        size += (size_t)max(width >> level, 1) * max(height >> level, 1) * channels;
+    return size;
+}
+
+
+// Append the mip levels below the base level in pixels, each a 2x2 box
+// filter of the one above
+// @return level count, base included
+int UBuildMipChain(vector<unsigned char>& pixels, int width, int height, int channels)
+{
+    int levels = 1;
+    pixels.reserve(UMipChainSize(width, height, channels, 32));
+    size_t offset = 0;
+    while (width > 1 || height > 1)
+    {
+        int w = max(width / 2, 1), h = max(height / 2, 1);
+        size_t next = pixels.size();
+        pixels.resize(next + (size_t)w * h * channels);
+        const unsigned char* above = &pixels[offset];
+        unsigned char* level = &pixels[next];
+        for (int y = 0; y < h; ++y)
+        {
+            const unsigned char* row0 = above + (size_t)min(2 * y, height - 1) * width * channels;
+            const unsigned char* row1 = above + (size_t)min(2 * y + 1, height - 1) * width * channels;
+            for (int x = 0; x < w; ++x)
+            {
+                int x0 = min(2 * x, width - 1) * channels, x1 = min(2 * x + 1, width - 1) * channels;
+                for (int c = 0; c < channels; ++c)
+                    level[((size_t)y * w + x) * channels + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+        offset = next;
+        width = w;
+        height = h;
+        ++levels;
+    }
+    return levels;
+}
+
+
+// Path of the cooked form of an image file
+string UTextureCachePath(const string& path)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)UHashBytes(path.data(), path.size()));
+    return gTextureCacheDir + "/" + name;
+}
+
+
+// Get every mip level of a texture ready for upload: mapped from its
+// cooked file when that was made from the image as it is now, else
+// decoded, flipped and filtered down here, and cooked for the next run
+void UPrepareTexture(const string& path, DecodedImage& image)
+{
+    error_code error;
+    TextureFileHeader stamp = {};
+    memcpy(stamp.magic, "PYRTEX01", 8);
+    stamp.sourceSize = filesystem::file_size(path, error);
+    if (!error)
+        stamp.sourceTime = (int64_t)filesystem::last_write_time(path, error).time_since_epoch().count();
+    bool useCache = !gTextureCacheDir.empty() && !error;
+
+    if (useCache && UMapFile(UTextureCachePath(path), image.mapped))
+    {
+        const TextureFileHeader* header = (const TextureFileHeader*)image.mapped.data;
+        if (image.mapped.size >= sizeof(TextureFileHeader) && memcmp(header->magic, stamp.magic, 8) == 0
+            && header->sourceSize == stamp.sourceSize && header->sourceTime == stamp.sourceTime
+            && image.mapped.size == sizeof(TextureFileHeader) + UMipChainSize(header->width, header->height, header->channels, header->levels))
+        {
+            image.width = header->width;
+            image.height = header->height;
+            image.channels = header->channels;
+            image.levels = header->levels;
+            image.fromCache = true;
+            return;
+        }
+        UUnmapFile(image.mapped);   // stale: cook it again
+    }
+
+    unsigned char* pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0);
+    if (pixels == nullptr)
+        return;
+
+    // Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so flip it
+    size_t rowBytes = (size_t)image.width * image.channels;
+    image.cooked.resize(rowBytes * image.height);
+    for (int y = 0; y < image.height; ++y)
+        memcpy(&image.cooked[y * rowBytes], pixels + (image.height - 1 - y) * rowBytes, rowBytes);
+    stbi_image_free(pixels);
+    image.levels = UBuildMipChain(image.cooked, image.width, image.height, image.channels);
+
+    if (!useCache)
+        return;
+    stamp.width = image.width;
+    stamp.height = image.height;
+    stamp.channels = image.channels;
+    stamp.levels = image.levels;
+    filesystem::create_directories(gTextureCacheDir, error);
+    string cachePath = UTextureCachePath(path);
+    string tempPath = cachePath + ".tmp";
+    {
+        ofstream file(tempPath, ios::binary | ios::trunc);
+        if (!file.write((const char*)&stamp, sizeof(stamp)) || !file.write((const char*)image.cooked.data(), image.cooked.size()))
+            return;
+    }
+    filesystem::rename(tempPath, cachePath, error);
+}
+
+
+// First byte of an image's base level, null if it failed to load
+const unsigned char* UImagePixels(const DecodedImage& image)
+{
+    if (image.mapped.data != nullptr)
+        return image.mapped.data + sizeof(TextureFileHeader);
+    return image.cooked.empty() ? nullptr : image.cooked.data();
+}
+
+
+// Worker thread: prepare queued textures until the manager stops
+void UDecodeTextures()
+{
+    TextureManager& manager = gTextures;
+    for (;;)
+    {
+        int texture;
+        string path;
+        {
+            unique_lock<mutex> guard(manager.lock);
+            manager.wake.wait(guard, [&] { return manager.stopping || !manager.decodeQueue.empty(); });
+            if (manager.stopping)
+                return;
+            texture = manager.decodeQueue.front();
+            manager.decodeQueue.pop_front();
+            path = manager.textures[texture].path;
+        }
+
+        DecodedImage image;
+        image.texture = texture;
+        UPrepareTexture(path, image);
+
+        lock_guard<mutex> guard(manager.lock);
+        manager.cacheHits += image.fromCache;
+        manager.decoded.push_back(move(image));
+    }
+}
+
+
+// Start the decode workers and map the upload buffer
+void UCreateTextureManager()
+{
+    TextureManager& manager = gTextures;
+    manager.startTime = chrono::steady_clock::now();
+
+    // one ring of upload slots, mapped once for the life of the program
+    glGenBuffers(1, &manager.pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, manager.pbo);
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, TEXTURE_PBO_SLOTS * TEXTURE_PBO_SLOT_SIZE, NULL, flags);
+    manager.pboMemory = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, TEXTURE_PBO_SLOTS * TEXTURE_PBO_SLOT_SIZE, flags);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // leave a core for the render thread
+    unsigned workers = min(max(thread::hardware_concurrency(), 2u) - 1, 4u);
+    for (unsigned i = 0; i < workers; ++i)
+        manager.workers.push_back(thread(UDecodeTextures));
+}
+
+
+// Texture for an image file, loaded once however often it is asked for.
+// The name is usable right away and shows a grey placeholder until the
+// image has been decoded and uploaded.
+GLuint UGetTexture(const char* filename)
+{
+    TextureManager& manager = gTextures;
+    unordered_map<string, int>::iterator found = manager.byPath.find(filename);
+    if (found != manager.byPath.end())
+    {
+        ++manager.sharedRequests;
+        return manager.textures[found->second].textureId;
+    }
+
+    ManagedTexture texture;
+    texture.path = filename;
+    texture.ready = false;
+    glGenTextures(1, &texture.textureId);
+    glBindTexture(GL_TEXTURE_2D, texture.textureId);
+
+    // set the texture wrapping parameters
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    // set texture filtering parameters
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    const unsigned char placeholder[] = { 128, 128, 128, 255 };
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    int index = (int)manager.textures.size();
+    manager.byPath[filename] = index;
+    {
+        lock_guard<mutex> guard(manager.lock);
+        manager.textures.push_back(texture);
+        manager.decodeQueue.push_back(index);
+    }
+    manager.wake.notify_one();
+    ++manager.pending;
+    return texture.textureId;
+}
+
+
+// Upload what the workers have prepared since the last frame. Each
+// image's mip chain is copied into a free slot of the mapped buffer and
+// every level specified from there, with no decoding or mip generation
+// left on this thread. A slot the GPU may still be reading stops the
+// uploads until the next frame rather than stalling this one.
+void UPumpTextures()
+{
+    TextureManager& manager = gTextures;
+    if (manager.pending == 0)
+        return;
+    {
+        lock_guard<mutex> guard(manager.lock);
+        manager.uploads.insert(manager.uploads.end(), make_move_iterator(manager.decoded.begin()), make_move_iterator(manager.decoded.end()));
+        manager.decoded.clear();
+    }
+
+    size_t done = 0;
+    for (; done < manager.uploads.size(); ++done)
+    {
+        DecodedImage& image = manager.uploads[done];
+        ManagedTexture& texture = manager.textures[image.texture];
+        const unsigned char* pixels = UImagePixels(image);
+        GLenum format = image.channels == 3 ? GL_RGB : image.channels == 4 ? GL_RGBA : 0;
+        if (pixels == nullptr || format == 0)
+        {
+            if (pixels == nullptr)
+                cout << "Failed to load texture " << texture.path << endl;
+            else
+                cout << "Not implemented to handle image with " << image.channels << " channels" << endl;
+            ++manager.failed;
+            --manager.pending;
+            continue;
+        }
+
+        size_t size = UMipChainSize(image.width, image.height, image.channels, image.levels);
+        const unsigned char* source = pixels;    // too big for a slot: straight from memory
+        bool viaPbo = size <= TEXTURE_PBO_SLOT_SIZE;
+        if (viaPbo)
+        {
+            GLsync& fence = manager.slotFences[manager.nextSlot];
+            if (fence != 0)
+            {
+                if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                    break;
+                glDeleteSync(fence);
+                fence = 0;
+            }
+            memcpy(manager.pboMemory + manager.nextSlot * TEXTURE_PBO_SLOT_SIZE, pixels, size);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, manager.pbo);
+            source = (const unsigned char*)(manager.nextSlot * TEXTURE_PBO_SLOT_SIZE);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, texture.textureId);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int level = 0; level < image.levels; ++level)
+        {
+            int width = max(image.width >> level, 1), height = max(image.height >> level, 1);
+            glTexImage2D(GL_TEXTURE_2D, level, format == GL_RGB ? GL_RGB8 : GL_RGBA8, width, height, 0, format, GL_UNSIGNED_BYTE, source);
+            source += (size_t)width * height * image.channels;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        if (viaPbo)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            manager.slotFences[manager.nextSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            manager.nextSlot = (manager.nextSlot + 1) % TEXTURE_PBO_SLOTS;
+        }
+        texture.ready = true;
+        --manager.pending;
+    }
+    for (size_t i = 0; i < done; ++i)
+        UUnmapFile(manager.uploads[i].mapped);
+    manager.uploads.erase(manager.uploads.begin(), manager.uploads.begin() + done);
+
+    if (manager.pending == 0)
+        cout << "Textures: " << manager.textures.size() - manager.failed << " uploaded (" << manager.cacheHits
+             << " from the texture cache), " << manager.failed << " failed, for "
+             << manager.textures.size() + manager.sharedRequests << " requests; done "
+             << 1000.0 * chrono::duration<double>(chrono::steady_clock::now() - manager.startTime).count()
+             << " ms after the first request" << endl;
+}
+
+
+// Stop the workers and release every texture and the upload buffer
+void UDestroyTextureManager()
+{
+    TextureManager& manager = gTextures;
+    {
+        lock_guard<mutex> guard(manager.lock);
+        manager.stopping = true;
+    }
+    manager.wake.notify_all();
+    for (size_t i = 0; i < manager.workers.size(); ++i)
+        manager.workers[i].join();
+
+    for (size_t i = 0; i < manager.decoded.size(); ++i)
+        UUnmapFile(manager.decoded[i].mapped);
+    for (size_t i = 0; i < manager.uploads.size(); ++i)
+        UUnmapFile(manager.uploads[i].mapped);
+    for (size_t i = 0; i < manager.textures.size(); ++i)
+        glDeleteTextures(1, &manager.textures[i].textureId);
+    for (int i = 0; i < TEXTURE_PBO_SLOTS; ++i)
+        if (manager.slotFences[i] != 0)
+            glDeleteSync(manager.slotFences[i]);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, manager.pbo);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &manager.pbo);
+}
+
+
+// Implements the UCreateShaders function
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+{
+    // Compilation and linkage error reporting
+    int success = 0;
+    char infoLog[512];
+
+    // Create a Shader program object.
+    programId = glCreateProgram();
+
+    // Create the vertex and fragment shader objects
+    GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
+    GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
+
+    // Retrive the shader source
+    glShaderSource(vertexShaderId, 1, &vtxShaderSource, NULL);
+    glShaderSource(fragmentShaderId, 1, &fragShaderSource, NULL);
+
+    // Compile the vertex shader, and print compilation errors (if any)
+    glCompileShader(vertexShaderId); // compile the vertex shader
+    // check for shader compile errors
+    glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(vertexShaderId, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+
+        return false;
+    }
+
+    glCompileShader(fragmentShaderId); // compile the fragment shader
+    // check for shader compile errors
+    glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
+        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+
+        return false;
+    }
+
+    // Attached compiled shaders to the shader program
+    glAttachShader(programId, vertexShaderId);
+    glAttachShader(programId, fragmentShaderId);
+
+    // keep the linked binary available for the on-disk program cache
+    glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    glLinkProgram(programId);   // links the shader program
+    // check for linking errors
+    glGetProgramiv(programId, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+
+        return false;
+    }
+
+    glUseProgram(programId);    // Uses the shader program
+
+    return true;
+}
+
+
+void UDestroyShaderProgram(GLuint programId)
+{
+    glDeleteProgram(programId);
+}
+
+
+// 64-bit FNV-1a, continued from hash
+uint64_t UHashBytes(const void* data, size_t size, uint64_t hash)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+// Identifies the driver build a program binary came from; any change of
+// vendor, renderer or version string makes the old binaries unusable
+uint64_t UDriverKey()
+{
+    const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+    uint64_t key = UHashBytes(nullptr, 0);
+    for (GLenum name : names)
+    {
+        const char* text = (const char*)glGetString(name);
+        if (text != nullptr)
+            key = UHashBytes(text, strlen(text) + 1, key);
+    }
+    return key;
+}
+
+
+// Path of the binary for a program built from the given sources
+string UProgramBinaryPath(uint64_t sourceHash, uint64_t driverKey)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx-%016llx.bin", (unsigned long long)sourceHash, (unsigned long long)driverKey);
+    return gShaderCacheDir + "/" + name;
+}
+
+
+// Create a program from a binary saved by an earlier run; false if there
+// is none or the driver refuses it
+bool ULoadProgramBinary(uint64_t sourceHash, uint64_t driverKey, GLuint& programId)
+{
+    ifstream file(UProgramBinaryPath(sourceHash, driverKey), ios::binary);
+    ProgramBinaryHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, "PYRPROG1", 8) != 0
+        || header.driverKey != driverKey || header.sourceHash != sourceHash || header.length <= 0)
+        return false;
+
+    vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size()))
+        return false;
+
+    programId = glCreateProgram();
+    glProgramBinary(programId, header.format, binary.data(), header.length);
+    GLint success = 0;
+    glGetProgramiv(programId, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glDeleteProgram(programId);
+        return false;
+    }
+    return true;
+}
+
+
+// Save a linked program's binary for the next run, through a temporary
+// file so a crash never leaves half a binary behind
+void USaveProgramBinary(uint64_t sourceHash, uint64_t driverKey, GLuint programId)
+{
+    ProgramBinaryHeader header;
+    memcpy(header.magic, "PYRPROG1", 8);
+    header.driverKey = driverKey;
+    header.sourceHash = sourceHash;
+    header.length = 0;
+    glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &header.length);
+    if (header.length <= 0)
+        return;
+
+    vector<char> binary(header.length);
+    glGetProgramBinary(programId, header.length, nullptr, &header.format, binary.data());
+
+    error_code error;
+    filesystem::create_directories(gShaderCacheDir, error);
+    string path = UProgramBinaryPath(sourceHash, driverKey);
+    string tempPath = path + ".tmp";
+    {
+        ofstream file(tempPath, ios::binary | ios::trunc);
+        if (!file.write((const char*)&header, sizeof(header)) || !file.write(binary.data(), binary.size()))
+            return;
+    }
+    filesystem::rename(tempPath, path, error);
+}
+
+
+// Get the program for a vertex/fragment source pair: shared with any
+// earlier request for the same sources, else loaded from a program
+// binary, else compiled and linked (and its binary saved)
+bool UGetShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+{
+    uint64_t sourceHash = UHashBytes(vtxShaderSource, strlen(vtxShaderSource) + 1);
+    sourceHash = UHashBytes(fragShaderSource, strlen(fragShaderSource) + 1, sourceHash);
+
+    unordered_map<uint64_t, GLuint>::iterator cached = gProgramCache.find(sourceHash);
+    if (cached != gProgramCache.end())
+    {
+        programId = cached->second;
+        ++gProgramsShared;
+        return true;
+    }
+
+    static const uint64_t driverKey = UDriverKey();
+    GLint binaryFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    bool useBinaries = !gShaderCacheDir.empty() && binaryFormats > 0;
+
+    if (useBinaries && ULoadProgramBinary(sourceHash, driverKey, programId))
+        ++gProgramsLoaded;
+    else
+    {
+        if (!UCreateShaderProgram(vtxShaderSource, fragShaderSource, programId))
+            return false;
+        ++gProgramsCompiled;
+        if (useBinaries)
+            USaveProgramBinary(sourceHash, driverKey, programId);
+    }
+
+    gProgramCache[sourceHash] = programId;
+    return true;
+}
+
+
+// Delete every program the cache handed out
+void UDestroyShaderCache()
+{
+    for (unordered_map<uint64_t, GLuint>::iterator it = gProgramCache.begin(); it != gProgramCache.end(); ++it)
+        UDestroyShaderProgram(it->second);
+    gProgramCache.clear();
+}
+
+
+// Resolve the per-object uniform locations of a linked program; names a
+// program doesn't use come back as -1, which glUniform* ignores
+GLProgramUniforms UGetProgramUniforms(GLuint programId)
+{
+    GLProgramUniforms uniforms;
+    uniforms.model = glGetUniformLocation(programId, "model");
+    uniforms.objectColor = glGetUniformLocation(programId, "objectColor");
+    uniforms.uvScale = glGetUniformLocation(programId, "uvScale");
+    uniforms.texture = glGetUniformLocation(programId, "uTexture");
+    return uniforms;
+}
+
+
+// Split one CSV line into fields, honouring double-quoted fields
+void USplitCsvLine(const string& line, vector<string>& fields)
+{
+    fields.clear();
+    string field;
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i)
+    {
+        char c = line[i];
+        if (quoted)
+        {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"')
+                field += line[++i];
+            else if (c == '"')
+                quoted = false;
+            else
+                field += c;
+        }
+        else if (c == '"')
+            quoted = true;
+        else if (c == ',')
+        {
+            fields.push_back(field);
+            field.clear();
+        }
+        else
+            field += c;
+    }
+    fields.push_back(field);
+}
+
+
+// Load a bid CSV (the eBid export or a --batch output of the sorting tool)
+// and build one instanced bar per bid, or per bucketSize bids of a fund
+// (0 picks the size from CHART_AUTO_BARS)
+bool UCreateBarChart(const char* filename, int bucketSize, GLBarChart& chart)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    ifstream file(filename);
+    string line;
+    vector<string> fields;
+    if (!file || !getline(file, line))
+        return false;
+
+    // find the columns by name, falling back to the eBid export layout
+    size_t amountColumn = 4;
+    size_t fundColumn = 8;
+    USplitCsvLine(line, fields);
+    for (size_t i = 0; i < fields.size(); ++i)
+    {
+        if (fields[i] == "WinningBid" || fields[i] == "Winning Bid" || fields[i] == "Amount")
+            amountColumn = i;
+        else if (fields[i] == "Fund")
+            fundColumn = i;
+    }
+
+    // amounts grouped by fund, funds numbered in order of appearance
+    vector<string> fundNames;
+    vector<vector<float> > fundAmounts;
+    unordered_map<string, size_t> fundIndex;
+    size_t bidCount = 0;
+    while (getline(file, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+        USplitCsvLine(line, fields);
+        if (fields.size() <= max(amountColumn, fundColumn))
+            continue;
+
+        string& amount = fields[amountColumn];
+        amount.erase(remove_if(amount.begin(), amount.end(), [](char c) { return c == '$' || c == ','; }), amount.end());
+
+        unordered_map<string, size_t>::iterator fund = fundIndex.find(fields[fundColumn]);
+        if (fund == fundIndex.end())
+        {
+            fund = fundIndex.emplace(fields[fundColumn], fundNames.size()).first;
+            fundNames.push_back(fields[fundColumn]);
+            fundAmounts.push_back(vector<float>());
+        }
+        fundAmounts[fund->second].push_back((float)atof(amount.c_str()));
+        ++bidCount;
+    }
+    if (bidCount == 0)
+        return false;
+    if (bucketSize <= 0)
+        bucketSize = (int)((bidCount + CHART_AUTO_BARS - 1) / CHART_AUTO_BARS);
+
+    // largest first; a bucket is the mean of bucketSize neighbouring bids
+    size_t totalColumns = 0;
+    float maxAmount = 0.0f;
+    for (size_t f = 0; f < fundAmounts.size(); ++f)
+    {
+        vector<float>& amounts = fundAmounts[f];
+        sort(amounts.begin(), amounts.end(), [](float a, float b) { return a > b; });
+        if (bucketSize > 1)
+        {
+            size_t buckets = (amounts.size() + bucketSize - 1) / bucketSize;
+            for (size_t b = 0; b < buckets; ++b)
+            {
+                size_t first = b * bucketSize;
+                size_t last = min(first + bucketSize, amounts.size());
+                float sum = 0.0f;
+                for (size_t i = first; i < last; ++i)
+                    sum += amounts[i];
+                amounts[b] = sum / (last - first);
+            }
+            amounts.resize(buckets);
+        }
+        totalColumns += (size_t)ceil(sqrt((double)amounts.size())) + 1;  // one column gap per fund
+        if (!amounts.empty())
+            maxAmount = max(maxAmount, amounts[0]);
+    }
+    if (maxAmount <= 0.0f)
+        maxAmount = 1.0f;
+
+    // each fund is a square block of bars, blocks side by side along x
+    // and the tallest bars at the back
+    static const GLuint palette[] = {
+        0xff3c8ce6, 0xff4bb43c, 0xff3c3cdc, 0xff32c8f0, 0xffb45aa0, 0xffc8b428, 0xff8c8c8c, 0xff5a78f0
+    };
+    const float pitch = CHART_WIDTH / totalColumns;
+    vector<BarInstance> instances;
+    instances.reserve(bidCount);
+    float blockX = -CHART_WIDTH / 2.0f;
+    for (size_t f = 0; f < fundAmounts.size(); ++f)
+    {
+        const vector<float>& amounts = fundAmounts[f];
+        size_t columns = (size_t)ceil(sqrt((double)amounts.size()));
+        size_t rows = columns > 0 ? (amounts.size() + columns - 1) / columns : 0;
+        // emitted front row first, so the depth test rejects what they hide
+        for (size_t i = amounts.size(); i-- > 0;)
+        {
+            BarInstance bar;
+            bar.x = blockX + (i % columns + 0.5f) * pitch;
+            bar.z = (rows / 2.0f - i / columns - 0.5f) * -pitch;
+            bar.height = CHART_HEIGHT * max(amounts[i], 0.0f) / maxAmount;
+            bar.color = palette[f % (sizeof(palette) / sizeof(palette[0]))];
+            instances.push_back(bar);
+        }
+        blockX += (columns + 1) * pitch;
+    }
+
+    // unit bar with its base at y = 0; the bottom face is never seen
+    const GLfloat barVerts[] = {
+        //Positions               Normals
+        -0.5f, 1.0f,  0.5f,     0.0f,  1.0f,  0.0f,
+         0.5f, 1.0f,  0.5f,     0.0f,  1.0f,  0.0f,
+         0.5f, 1.0f, -0.5f,     0.0f,  1.0f,  0.0f,
+        -0.5f, 1.0f, -0.5f,     0.0f,  1.0f,  0.0f,
+
+        -0.5f, 0.0f,  0.5f,     0.0f,  0.0f,  1.0f,
+         0.5f, 0.0f,  0.5f,     0.0f,  0.0f,  1.0f,
+         0.5f, 1.0f,  0.5f,     0.0f,  0.0f,  1.0f,
+        -0.5f, 1.0f,  0.5f,     0.0f,  0.0f,  1.0f,
+
+         0.5f, 0.0f, -0.5f,     0.0f,  0.0f, -1.0f,
+        -0.5f, 0.0f, -0.5f,     0.0f,  0.0f, -1.0f,
+        -0.5f, 1.0f, -0.5f,     0.0f,  0.0f, -1.0f,
+         0.5f, 1.0f, -0.5f,     0.0f,  0.0f, -1.0f,
+
+        -0.5f, 0.0f, -0.5f,    -1.0f,  0.0f,  0.0f,
+        -0.5f, 0.0f,  0.5f,    -1.0f,  0.0f,  0.0f,
+        -0.5f, 1.0f,  0.5f,    -1.0f,  0.0f,  0.0f,
+        -0.5f, 1.0f, -0.5f,    -1.0f,  0.0f,  0.0f,
+
+         0.5f, 0.0f,  0.5f,     1.0f,  0.0f,  0.0f,
+         0.5f, 0.0f, -0.5f,     1.0f,  0.0f,  0.0f,
+         0.5f, 1.0f, -0.5f,     1.0f,  0.0f,  0.0f,
+         0.5f, 1.0f,  0.5f,     1.0f,  0.0f,  0.0f,
+    };
+    GLushort barIndices[30];
+    for (int face = 0; face < 5; ++face)
+    {
+        const GLushort quad[] = { 0, 1, 2, 2, 3, 0 };
+        for (int i = 0; i < 6; ++i)
+            barIndices[face * 6 + i] = face * 4 + quad[i];
+    }
+
+    if (!UGetShaderProgram(barVertexShaderSource, barFragmentShaderSource, chart.programId))
+        return false;
+    chart.barWidthLoc = glGetUniformLocation(chart.programId, "barWidth");
+    chart.baseYLoc = glGetUniformLocation(chart.programId, "baseY");
+
+    glGenVertexArrays(1, &chart.vao);
+    glBindVertexArray(chart.vao);
+
+    glGenBuffers(1, &chart.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, chart.vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(barVerts), barVerts, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), 0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(1);
+
+    glGenBuffers(1, &chart.ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chart.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(barIndices), barIndices, GL_STATIC_DRAW);
+    chart.indexCount = sizeof(barIndices) / sizeof(barIndices[0]);
+
+    // every bar in one buffer, advanced once per instance
+    glGenBuffers(1, &chart.instanceVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, chart.instanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(BarInstance), instances.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(BarInstance), 0);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BarInstance), (void*)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+
+    glBindVertexArray(0);
+    chart.instanceCount = (GLsizei)instances.size();
+    chart.barWidth = pitch * 0.8f;
+
+    cout << "Bar chart: " << chart.instanceCount << " bars from " << bidCount << " bids in " << fundNames.size()
+         << " funds (" << bucketSize << " bids per bar), " << instances.size() * sizeof(BarInstance) / (1024.0 * 1024.0) << " MB of instance data, built in "
+         << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " sec" << endl;
+    for (size_t f = 0; f < fundNames.size(); ++f)
+    {
+        GLuint color = palette[f % (sizeof(palette) / sizeof(palette[0]))];
+        cout << "  " << fundNames[f] << ": rgb(" << (color & 0xff) << ", " << ((color >> 8) & 0xff) << ", "
+             << ((color >> 16) & 0xff) << ")" << endl;
+    }
+    return true;
+}
+
+
+void UDestroyBarChart(GLBarChart& chart)
+{
+    if (chart.vao == 0)
+        return;
+    glDeleteVertexArrays(1, &chart.vao);
+    glDeleteBuffers(1, &chart.vbo);
+    glDeleteBuffers(1, &chart.ibo);
+    glDeleteBuffers(1, &chart.instanceVbo);
+    chart = GLBarChart();
+}
+
+
+// Draw every bar of the bid chart with a single instanced call
+void URenderBarChart()
+{
+    // camera and lights come from the frame uniform block
+    glUseProgram(gBarChart.programId);
+    glUniform1f(gBarChart.barWidthLoc, gBarChart.barWidth);
+    glUniform1f(gBarChart.baseYLoc, CHART_BASE);
+
+    // back faces of the closed sides never show
+    glEnable(GL_CULL_FACE);
+    glBindVertexArray(gBarChart.vao);
+    glDrawElementsInstanced(GL_TRIANGLES, gBarChart.indexCount, GL_UNSIGNED_SHORT, NULL, gBarChart.instanceCount);
+    glBindVertexArray(0);
+    glDisable(GL_CULL_FACE);
+    glUseProgram(0);
 }
\ No newline at end of file